@@ -32,7 +32,7 @@ void Arguments::setArgs(int argc, char* argv[])
 	{
 		if (args[i].length())
 		{
-			if (args[i][0] == '-' || args[i][0] == '/')
+			if (args[i][0] == '-' || (args[i][0] == '/' && args[i].find('/', 1) == std::string::npos))
 			{
 				flags.push_back(args[i].data() + 1);
 
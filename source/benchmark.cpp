@@ -0,0 +1,926 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <new>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <thread>
+#include <fstream>
+#include <algorithm>
+#include <condition_variable>
+
+#include <sys/resource.h>
+
+#include "server.hpp"
+#include "client.hpp"
+#include "scanner.hpp"
+#include "sanitizer.hpp"
+
+std::atomic<bool> measuring(false);
+
+std::atomic<unsigned long long> allocations(0);
+std::atomic<unsigned long long> allocatedBytes(0);
+
+thread_local bool countAllocations = true;
+
+__attribute__((noinline)) void* allocate(std::size_t size) noexcept
+{
+	if (measuring && countAllocations)
+	{
+		allocations++;
+
+		allocatedBytes += size;
+	}
+
+	return std::malloc(size > 0 ? size : 1);
+}
+
+__attribute__((noinline)) void release(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void* operator new(std::size_t size)
+{
+	void* pointer = allocate(size);
+
+	if (!pointer)
+	{
+		throw std::bad_alloc();
+	}
+
+	return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+	return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	release(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+	release(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+	release(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	release(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	release(pointer);
+}
+
+#endif
+
+std::size_t drain(TcpSocket& tcpSocket)
+{
+	std::size_t count = 0;
+
+	tcpSocket.process();
+
+	StringView line;
+
+	while (tcpSocket.readLine(line))
+	{
+		if (line.data[0] != '\b')
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+void awaitLines(TcpSocket& tcpSocket, std::size_t lines)
+{
+	std::size_t received = 0;
+
+	while (received < lines && tcpSocket.isConnected())
+	{
+		received += drain(tcpSocket);
+
+		tcpSocket.wait(std::chrono::milliseconds(10));
+	}
+}
+
+void benchmarkRelay(unsigned short port, std::size_t messages, const std::string& path = std::string())
+{
+	Server server(port);
+
+	std::string address = "localhost:" + std::to_string(port);
+
+	if (!path.empty())
+	{
+		server.listenUnix(path);
+
+		address = Network::UnixPrefix + path;
+	}
+
+	TcpSocket sender;
+	TcpSocket receiver;
+
+	receiver.connect(address);
+	receiver.writeLine("receiver");
+
+	awaitLines(receiver, 1);
+
+	sender.connect(address);
+	sender.writeLine("sender");
+
+	awaitLines(receiver, 1);
+
+	std::string message = "The quick brown fox jumps over the lazy dog";
+
+	std::size_t received = 0;
+
+	unsigned long long coldCount = 0;
+	unsigned long long count = 0;
+
+	float time = 0.0f;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		unsigned long long before = allocations;
+
+		measuring = true;
+
+		std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+		received = 0;
+
+		for (std::size_t i = 0; i < messages; i++)
+		{
+			sender.writeLine(message);
+
+			if (i % 64 == 63)
+			{
+				drain(sender);
+
+				received += drain(receiver);
+			}
+		}
+
+		while (received < messages && receiver.isConnected())
+		{
+			drain(sender);
+
+			received += drain(receiver);
+
+			receiver.wait(std::chrono::milliseconds(10));
+		}
+
+		std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+		measuring = false;
+
+		if (pass == 0)
+		{
+			coldCount = allocations - before;
+		}
+		else
+		{
+			count = allocations - before;
+		}
+
+		time = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+	}
+
+	std::cout << "relay" << (path.empty() ? "" : " (unix)") << ": " << received << " messages in " << time << " s, "
+		<< static_cast<float>(received) / time << " messages/s, "
+		<< static_cast<float>(count) / static_cast<float>(messages) << " server allocations/message, "
+		<< static_cast<float>(coldCount) / static_cast<float>(messages) << " on the first pass" << std::endl;
+}
+
+void benchmarkSkewed(unsigned short port, std::size_t senders, std::size_t messages, double exponent)
+{
+	Server server(port);
+
+	TcpSocket receiver;
+
+	receiver.connect("localhost", port);
+	receiver.writeLine("receiver");
+
+	awaitLines(receiver, 1);
+
+	std::vector<std::unique_ptr<TcpSocket>> sockets;
+
+	for (std::size_t i = 0; i < senders; i++)
+	{
+		sockets.push_back(std::unique_ptr<TcpSocket>(new TcpSocket()));
+
+		sockets.back()->connect("localhost", port);
+		sockets.back()->writeLine("sender" + std::to_string(i));
+	}
+
+	awaitLines(receiver, senders);
+
+	std::size_t received = 0;
+
+	std::vector<double> weights;
+
+	for (std::size_t i = 0; i < senders; i++)
+	{
+		weights.push_back(1.0 / std::pow(static_cast<double>(i + 1), exponent));
+	}
+
+	std::mt19937 random(42);
+
+	std::discrete_distribution<std::size_t> distribution(weights.begin(), weights.end());
+
+	std::string message = "The quick brown fox jumps over the lazy dog";
+
+	unsigned long long stolen = Metrics::get(Metrics::TasksStolen);
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	received = 0;
+
+	for (std::size_t i = 0; i < messages; i++)
+	{
+		sockets[distribution(random)]->writeLine(message);
+
+		if (i % 64 == 63)
+		{
+			for (auto& sender : sockets)
+			{
+				drain(*sender);
+			}
+
+			received += drain(receiver);
+		}
+	}
+
+	while (received < messages && receiver.isConnected())
+	{
+		for (auto& sender : sockets)
+		{
+			drain(*sender);
+		}
+
+		received += drain(receiver);
+
+		receiver.wait(std::chrono::milliseconds(10));
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	float time = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+
+	std::cout << "skewed (" << senders << " senders, zipf " << exponent << "): " << received << " messages in " << time << " s, "
+		<< static_cast<float>(received) / time << " messages/s, "
+		<< Metrics::get(Metrics::TasksStolen) - stolen << " tasks stolen" << std::endl;
+}
+
+void benchmarkSanitizer(const std::string& name, const std::string& alphabet, std::size_t lineLength, std::size_t bytes, std::size_t rounds)
+{
+	std::mt19937 random(42);
+
+	std::uniform_int_distribution<std::size_t> characters(0, alphabet.length() - 1);
+
+	std::vector<std::string> lines;
+
+	std::size_t total = 0;
+
+	while (total < bytes)
+	{
+		std::string line;
+
+		while (line.length() < lineLength)
+		{
+			char character = alphabet[characters(random)];
+
+			if (static_cast<unsigned char>(character) >= 0xC0)
+			{
+				line.append("\xC3\xA9");
+			}
+			else
+			{
+				line.push_back(character);
+			}
+		}
+
+		total += line.length();
+
+		lines.push_back(line);
+	}
+
+	std::string output;
+
+	std::size_t altered = 0;
+
+	float gigabytes = static_cast<float>(total * rounds) / (1024.0f * 1024.0f * 1024.0f);
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	for (std::size_t i = 0; i < rounds; i++)
+	{
+		for (auto& line : lines)
+		{
+			output.clear();
+
+			altered += Sanitizer::sanitize(line.data(), line.length(), output) ? 1 : 0;
+		}
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	std::cout << "sanitizer (" << name << ", " << lineLength << " byte lines): "
+		<< gigabytes / std::chrono::duration<float, std::chrono::seconds::period>(end - start).count() << " GB/s, "
+		<< altered / rounds << " of " << lines.size() << " lines altered";
+
+	Scanner::Kernel kernels[] = { Scanner::Scalar, Scanner::Sse2, Scanner::Avx2 };
+
+	for (Scanner::Kernel kernel : kernels)
+	{
+		if (!Scanner::isSupported(kernel))
+		{
+			continue;
+		}
+
+		std::size_t skipped = 0;
+
+		start = std::chrono::high_resolution_clock::now();
+
+		for (std::size_t i = 0; i < rounds; i++)
+		{
+			for (auto& line : lines)
+			{
+				skipped += Scanner::skipPrintable(kernel, line.data(), 0, line.length());
+			}
+		}
+
+		end = std::chrono::high_resolution_clock::now();
+
+		std::cout << ", " << Scanner::getName(kernel) << " skip "
+			<< static_cast<float>(skipped) / (1024.0f * 1024.0f * 1024.0f) / std::chrono::duration<float, std::chrono::seconds::period>(end - start).count() << " GB/s";
+	}
+
+	std::cout << std::endl;
+}
+
+std::size_t getResidentBytes()
+{
+	std::ifstream statm("/proc/self/statm");
+
+	std::size_t pages = 0;
+	std::size_t resident = 0;
+
+	statm >> pages >> resident;
+
+	return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void benchmarkStreaming(unsigned short port, std::size_t bytes)
+{
+	Server server(port);
+
+	TcpSocket receiver;
+
+	receiver.connect("localhost", port);
+	receiver.writeLine("receiver");
+
+	awaitLines(receiver, 1);
+
+	Endpoint endpoint = Network::resolve("127.0.0.1", port).front();
+
+	Socket sender = ::socket(endpoint.getFamily(), SOCK_STREAM, 0);
+
+	if (::connect(sender, endpoint.getAddress(), endpoint.length) != 0)
+	{
+		throw std::runtime_error("Failed to connect the streaming sender");
+	}
+
+	std::string name = "sender\n";
+
+	::send(sender, name.data(), name.length(), MSG_NOSIGNAL);
+
+	awaitLines(receiver, 1);
+
+	std::size_t baseline = getResidentBytes();
+	std::size_t peak = baseline;
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	std::thread thread([sender, bytes]()
+	{
+		std::string block(64 * 1024, 'x');
+
+		std::string echo(64 * 1024, 0);
+
+		for (std::size_t sent = 0; sent < bytes; sent += block.length())
+		{
+			::send(sender, block.data(), block.length(), MSG_NOSIGNAL);
+
+			while (::recv(sender, &echo[0], echo.length(), MSG_DONTWAIT) > 0)
+			{
+
+			}
+		}
+
+		::send(sender, "\n", 1, MSG_NOSIGNAL);
+	});
+
+	std::size_t chunks = 0;
+
+	bool done = false;
+
+	while (!done && receiver.isConnected())
+	{
+		receiver.process();
+
+		StringView line;
+
+		while (receiver.readLine(line))
+		{
+			if (line.length > 1 && line.data[0] == '\b' && (line.data[1] == 'k' || line.data[1] == 'K'))
+			{
+				chunks++;
+
+				done = line.data[1] == 'K';
+			}
+		}
+
+		peak = std::max(peak, getResidentBytes());
+
+		receiver.wait(std::chrono::milliseconds(1));
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	thread.join();
+
+	::close(sender);
+
+	float time = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+
+	std::cout << "streaming: " << bytes / (1024 * 1024) << " MB message in " << chunks << " chunks, "
+		<< static_cast<float>(bytes) / (1024.0f * 1024.0f) / time << " MB/s, peak resident growth "
+		<< (peak - baseline) / 1024 << " KB" << std::endl;
+}
+
+void benchmarkConnections(std::size_t slots, std::size_t scans)
+{
+	countAllocations = true;
+
+	measuring = true;
+
+	unsigned long long bytes = allocatedBytes;
+
+	std::vector<std::shared_ptr<User>> users;
+
+	users.reserve(slots);
+
+	for (std::size_t i = 0; i < slots; i++)
+	{
+		users.push_back(std::shared_ptr<User>(new User()));
+	}
+
+	unsigned long long vectorBytes = allocatedBytes - bytes;
+
+	bytes = allocatedBytes;
+
+	Connections connections;
+
+	for (std::size_t i = 0; i < slots; i++)
+	{
+		connections.hot(Connections::getIndex(connections.allocate())).state = Connection::Open;
+	}
+
+	unsigned long long slabBytes = allocatedBytes - bytes;
+
+	measuring = false;
+
+	countAllocations = false;
+
+	std::size_t open = 0;
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	for (std::size_t i = 0; i < scans; i++)
+	{
+		for (auto& user : users)
+		{
+			open += user->isConnected() ? 1 : 0;
+		}
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> middle = std::chrono::high_resolution_clock::now();
+
+	for (std::size_t i = 0; i < scans; i++)
+	{
+		for (std::size_t j = 0; j < connections.getSlotCount(); j++)
+		{
+			open += connections.hot(j).state == Connection::Open ? 1 : 0;
+		}
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	float vectorTime = std::chrono::duration<float, std::chrono::microseconds::period>(middle - start).count() / static_cast<float>(scans);
+	float slabTime = std::chrono::duration<float, std::chrono::microseconds::period>(end - middle).count() / static_cast<float>(scans);
+
+	std::cout << "connections (" << slots << " slots, " << open / scans << " open): "
+		<< "vector<shared_ptr<User>> " << vectorBytes / slots << " bytes/connection, " << vectorTime << " us/scan; "
+		<< "slab " << slabBytes / slots << " bytes/connection, " << slabTime << " us/scan" << std::endl;
+}
+
+void benchmarkScanner(const std::string& name, std::size_t minimumLength, std::size_t maximumLength, std::size_t bytes, std::size_t rounds)
+{
+	std::mt19937 random(42);
+
+	std::uniform_int_distribution<std::size_t> lengths(minimumLength, maximumLength);
+	std::uniform_int_distribution<int> characters(' ', '~');
+
+	std::string buffer;
+
+	while (buffer.length() < bytes)
+	{
+		std::size_t length = lengths(random);
+
+		for (std::size_t i = 0; i < length; i++)
+		{
+			buffer.push_back(static_cast<char>(characters(random)));
+		}
+
+		buffer.push_back('\n');
+	}
+
+	std::vector<std::size_t> positions;
+
+	positions.reserve(buffer.length() / (minimumLength + 1) + 1);
+
+	std::size_t expected = 0;
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	for (std::size_t i = 0; i < rounds; i++)
+	{
+		positions.clear();
+
+		std::size_t position = 0;
+		std::size_t offset = 0;
+
+		while ((position = buffer.find('\n', offset)) != std::string::npos)
+		{
+			positions.push_back(position);
+
+			offset = position + 1;
+		}
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	expected = positions.size();
+
+	float total = static_cast<float>(buffer.length() * rounds) / (1024.0f * 1024.0f * 1024.0f);
+
+	std::cout << "scanner (" << name << " lines, " << expected << " lines): find "
+		<< total / std::chrono::duration<float, std::chrono::seconds::period>(end - start).count() << " GB/s";
+
+	Scanner::Kernel kernels[] = { Scanner::Scalar, Scanner::Sse2, Scanner::Avx2 };
+
+	for (Scanner::Kernel kernel : kernels)
+	{
+		if (!Scanner::isSupported(kernel))
+		{
+			continue;
+		}
+
+		start = std::chrono::high_resolution_clock::now();
+
+		for (std::size_t i = 0; i < rounds; i++)
+		{
+			positions.clear();
+
+			Scanner::scan(kernel, buffer.data(), 0, buffer.length(), positions);
+		}
+
+		end = std::chrono::high_resolution_clock::now();
+
+		if (positions.size() != expected)
+		{
+			throw std::runtime_error(std::string("The ") + Scanner::getName(kernel) + " scanner found the wrong number of lines");
+		}
+
+		std::cout << ", " << Scanner::getName(kernel) << " "
+			<< total / std::chrono::duration<float, std::chrono::seconds::period>(end - start).count() << " GB/s";
+	}
+
+	std::cout << std::endl;
+}
+
+void benchmarkTransport(const std::string& name, TcpSocket& listener, const std::string& address, std::size_t roundTrips)
+{
+	TcpSocket client;
+	TcpSocket server;
+
+	client.connect(address);
+
+	while (!listener.accept(server))
+	{
+		listener.wait(std::chrono::milliseconds(10));
+	}
+
+	std::string message = "The quick brown fox jumps over the lazy dog";
+
+	StringView line;
+
+	std::size_t completed = 0;
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	for (std::size_t i = 0; i < roundTrips; i++)
+	{
+		client.writeLine(message);
+
+		while (server.isConnected() && !server.readLine(line))
+		{
+			server.wait(std::chrono::milliseconds(100));
+
+			server.process();
+		}
+
+		server.writeLine(line);
+
+		while (client.isConnected() && !client.readLine(line))
+		{
+			client.wait(std::chrono::milliseconds(100));
+
+			client.process();
+		}
+
+		if (!client.isConnected() || !server.isConnected())
+		{
+			break;
+		}
+
+		completed++;
+	}
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	float time = std::chrono::duration<float, std::chrono::seconds::period>(end - start).count();
+
+	std::cout << "transport (" << name << "): " << completed << " round trips in " << time << " s, "
+		<< static_cast<float>(completed) / time << " round trips/s, "
+		<< time * 1000000.0f / static_cast<float>(completed) << " us/round trip" << std::endl;
+}
+
+void benchmarkEcho(unsigned short port, std::size_t messages, bool local)
+{
+	Server server(port);
+
+	std::string address = "localhost:" + std::to_string(port);
+
+	std::mutex mutex;
+	std::condition_variable condition;
+
+	std::size_t received = 0;
+
+	std::unique_ptr<Client> client(local ? new Client("host", server, address) : new Client("host", address));
+
+	client->setMessageHandler([&](const std::string&)
+	{
+		std::lock_guard<std::mutex> lockGuard(mutex);
+
+		received++;
+
+		condition.notify_one();
+	});
+
+	std::vector<double> latencies;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	condition.wait_for(lock, std::chrono::seconds(5), [&]() { return received > 0; });
+
+	for (std::size_t i = 0; i < messages; i++)
+	{
+		std::size_t expected = received + 1;
+
+		lock.unlock();
+
+		std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+		client->sendMessage("echo");
+
+		lock.lock();
+
+		if (!condition.wait_for(lock, std::chrono::seconds(1), [&]() { return received >= expected; }))
+		{
+			break;
+		}
+
+		latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+
+	lock.unlock();
+
+	std::sort(latencies.begin(), latencies.end());
+
+	if (latencies.empty())
+	{
+		std::cout << "echo " << (local ? "local" : "tcp") << ": no messages echoed" << std::endl;
+
+		return;
+	}
+
+	std::cout << "echo " << (local ? "local" : "tcp") << ": " << latencies.size() << " round trips, p50 "
+		<< latencies[latencies.size() / 2] << " us, p99 " << latencies[latencies.size() * 99 / 100] << " us" << std::endl;
+}
+
+void benchmarkHandoff(unsigned short port, const std::string& control, std::size_t connections)
+{
+	rlimit limit;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0)
+	{
+		limit.rlim_cur = limit.rlim_max;
+
+		setrlimit(RLIMIT_NOFILE, &limit);
+
+		connections = std::min<std::size_t>(connections, (static_cast<std::size_t>(limit.rlim_cur) - 256) / 3);
+	}
+
+	std::string address = "localhost:" + std::to_string(port);
+
+	std::unique_ptr<Server> server(new Server(port, Network::MaxConnections, control));
+
+	unsigned long long accepted = Metrics::get(Metrics::AcceptedConnections);
+
+	TcpSocket sender;
+	TcpSocket receiver;
+
+	sender.connect(address);
+	sender.writeLine("sender");
+
+	receiver.connect(address);
+	receiver.writeLine("receiver");
+
+	std::vector<std::unique_ptr<TcpSocket>> clients;
+
+	for (std::size_t i = 0; i < connections; i++)
+	{
+		clients.push_back(std::unique_ptr<TcpSocket>(new TcpSocket()));
+
+		clients.back()->connect(address);
+	}
+
+	while (Metrics::get(Metrics::AcceptedConnections) < accepted + connections + 2)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	auto awaitLine = [](TcpSocket& tcpSocket, const std::string& expected)
+	{
+		std::chrono::time_point<std::chrono::steady_clock> deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+
+		while (tcpSocket.isConnected() && std::chrono::steady_clock::now() < deadline)
+		{
+			tcpSocket.process();
+
+			while (tcpSocket.hasLine())
+			{
+				if (tcpSocket.readLine() == expected)
+				{
+					return true;
+				}
+			}
+
+			tcpSocket.wait(std::chrono::milliseconds(10));
+		}
+
+		return false;
+	};
+
+	sender.writeLine("before");
+
+	bool before = awaitLine(receiver, "sender: before");
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+
+	std::unique_ptr<Server> successor(new Server(port, Network::MaxConnections, control));
+
+	std::chrono::time_point<std::chrono::high_resolution_clock> end = std::chrono::high_resolution_clock::now();
+
+	sender.writeLine("after");
+
+	bool after = awaitLine(receiver, "sender: after");
+
+	server.reset();
+
+	float time = std::chrono::duration<float, std::milli>(end - start).count();
+
+	std::cout << "handoff: " << connections + 2 << " connections in " << time << " ms, "
+		<< time * 1000.0f / static_cast<float>(connections + 2) << " us/connection, "
+		<< (before && after && receiver.isConnected() ? "chat continued" : "chat interrupted") << std::endl;
+}
+
+int main()
+{
+	countAllocations = false;
+
+	try
+	{
+		benchmarkScanner("short", 4, 40, 16 * 1024 * 1024, 20);
+
+		benchmarkScanner("mixed", 1, 400, 16 * 1024 * 1024, 20);
+
+		benchmarkScanner("long", 1000, 4000, 16 * 1024 * 1024, 20);
+
+		benchmarkSanitizer("ascii", "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ.,!?", 120, 16 * 1024 * 1024, 10);
+
+		benchmarkSanitizer("utf-8", "abcdefghijklmnopqrstuvwxyz \xC3", 120, 16 * 1024 * 1024, 10);
+
+		benchmarkSanitizer("hostile", "abcdefghijklmnopqrstuvwxyz\x1B\x07\x9B\xFF", 120, 16 * 1024 * 1024, 10);
+
+		benchmarkStreaming(47004, 256 * 1024 * 1024);
+
+		benchmarkConnections(10000, 1000);
+
+		TcpSocket tcpListener;
+
+		tcpListener.bind(47007);
+		tcpListener.listen();
+
+		benchmarkTransport("tcp", tcpListener, "localhost:47007", 100000);
+
+		TcpSocket unixListener;
+
+		unixListener.bind("/tmp/terminal-chat-benchmark.sock");
+		unixListener.listen();
+
+		benchmarkTransport("unix", unixListener, "unix:/tmp/terminal-chat-benchmark.sock", 100000);
+
+		benchmarkRelay(47001, 100000);
+
+		benchmarkRelay(47008, 100000, "/tmp/terminal-chat-relay.sock");
+
+		benchmarkEcho(47005, 1000, false);
+
+		benchmarkEcho(47006, 1000, true);
+
+		benchmarkSkewed(47002, 16, 100000, 0.0);
+
+		benchmarkSkewed(47003, 16, 100000, 1.2);
+
+		benchmarkHandoff(47009, "/tmp/terminal-chat-handoff.sock", 10000);
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		std::cerr << runtimeError.what() << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,190 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capture.hpp"
+
+#include <stdexcept>
+
+Capture::Capture(const std::string& path) : file(path, std::ios::binary | std::ios::trunc), last(std::chrono::steady_clock::now()), next(0)
+{
+	if (!this->file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	this->file.write(Magic.data(), static_cast<std::streamsize>(Magic.length()));
+}
+
+void Capture::record(unsigned long long connection, Type type, const StringView& line, const std::chrono::steady_clock::time_point& time)
+{
+	std::unordered_map<unsigned long long, unsigned int>::iterator iter = this->connections.find(connection);
+
+	if (iter == this->connections.end())
+	{
+		if (type == Close)
+		{
+			return;
+		}
+
+		iter = this->connections.insert(std::make_pair(connection, this->next++)).first;
+
+		this->write(Open, iter->second, StringView(), time);
+	}
+
+	if (type == Open)
+	{
+		return;
+	}
+
+	this->write(type, iter->second, line, time);
+
+	if (type == Close)
+	{
+		this->connections.erase(iter);
+	}
+}
+
+void Capture::flush()
+{
+	this->file.flush();
+}
+
+std::vector<Capture::Record> Capture::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	std::string magic(Magic.length(), 0);
+
+	if (!file.read(&magic[0], static_cast<std::streamsize>(magic.length())) || magic != Magic)
+	{
+		throw std::runtime_error(path + " is not a capture file");
+	}
+
+	std::vector<Record> records;
+
+	unsigned long long time = 0;
+
+	int type = 0;
+
+	while ((type = file.get()) != EOF && type <= Close)
+	{
+		unsigned long long delta = 0;
+		unsigned long long connection = 0;
+		unsigned long long length = 0;
+
+		if (!readNumber(file, delta) || !readNumber(file, connection))
+		{
+			break;
+		}
+
+		Record record;
+
+		time += delta;
+
+		record.type = static_cast<Type>(type);
+		record.time = time;
+		record.connection = static_cast<unsigned int>(connection);
+
+		if (type == Line || type == Part)
+		{
+			if (!readNumber(file, length) || length > MaxLineLength)
+			{
+				break;
+			}
+
+			record.line.resize(static_cast<std::size_t>(length));
+
+			if (length > 0 && !file.read(&record.line[0], static_cast<std::streamsize>(length)))
+			{
+				break;
+			}
+		}
+
+		records.push_back(record);
+	}
+
+	return records;
+}
+
+void Capture::write(Type type, unsigned int connection, const StringView& line, const std::chrono::steady_clock::time_point& time)
+{
+	unsigned long long delta = 0;
+
+	if (time > this->last)
+	{
+		delta = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(time - this->last).count());
+
+		this->last += std::chrono::microseconds(delta);
+	}
+
+	this->file.put(static_cast<char>(type));
+
+	this->writeNumber(delta);
+	this->writeNumber(connection);
+
+	if (type == Line || type == Part)
+	{
+		this->writeNumber(line.length);
+
+		this->file.write(line.data, static_cast<std::streamsize>(line.length));
+	}
+}
+
+void Capture::writeNumber(unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		this->file.put(static_cast<char>((value & 0x7f) | 0x80));
+
+		value >>= 7;
+	}
+
+	this->file.put(static_cast<char>(value));
+}
+
+bool Capture::readNumber(std::istream& stream, unsigned long long& value)
+{
+	value = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7)
+	{
+		int byte = stream.get();
+
+		if (byte == EOF)
+		{
+			return false;
+		}
+
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+
+		if ((byte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const std::string Capture::Magic("TCCAP\x01", 6);
+
+const unsigned long long Capture::MaxLineLength = 16 * 1024 * 1024;
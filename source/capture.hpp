@@ -0,0 +1,76 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <unordered_map>
+
+#include "string-view.hpp"
+
+class Capture
+{
+public:
+	enum Type
+	{
+		Open,
+		Line,
+		Part,
+		Close
+	};
+
+	struct Record
+	{
+		Type type;
+
+		unsigned long long time;
+
+		unsigned int connection;
+
+		std::string line;
+	};
+
+	Capture(const std::string& path);
+
+	void record(unsigned long long connection, Type type, const StringView& line, const std::chrono::steady_clock::time_point& time);
+
+	void flush();
+
+	static std::vector<Record> load(const std::string& path);
+
+private:
+	void write(Type type, unsigned int connection, const StringView& line, const std::chrono::steady_clock::time_point& time);
+
+	void writeNumber(unsigned long long value);
+
+	static bool readNumber(std::istream& stream, unsigned long long& value);
+
+	static const std::string Magic;
+
+	static const unsigned long long MaxLineLength;
+
+	std::ofstream file;
+
+	std::chrono::steady_clock::time_point last;
+
+	std::unordered_map<unsigned long long, unsigned int> connections;
+
+	unsigned int next;
+};
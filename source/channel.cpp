@@ -0,0 +1,133 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "channel.hpp"
+
+#include <algorithm>
+
+Channel::Channel() : offset(0), closed(false)
+{
+
+}
+
+bool Channel::writeLine(std::initializer_list<StringView> parts)
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	if (this->closed)
+	{
+		return false;
+	}
+
+	for (const StringView& part : parts)
+	{
+		this->buffer.append(part.data, part.length);
+	}
+
+	this->buffer += '\n';
+
+	this->condition.notify_one();
+
+	if (this->notifier)
+	{
+		this->notifier();
+	}
+
+	return true;
+}
+
+std::size_t Channel::read(std::string& buffer, std::size_t limit)
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	std::size_t length = std::min(limit, this->buffer.length() - this->offset);
+
+	buffer.append(this->buffer, this->offset, length);
+
+	this->offset += length;
+
+	if (this->offset == this->buffer.length())
+	{
+		this->buffer.clear();
+
+		this->offset = 0;
+
+		if (this->buffer.capacity() > RetainedCapacity)
+		{
+			std::string().swap(this->buffer);
+		}
+	}
+	else if (this->offset > this->buffer.length() / 2)
+	{
+		this->buffer.erase(0, this->offset);
+
+		this->offset = 0;
+	}
+
+	return length;
+}
+
+std::size_t Channel::getSize() const
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	return this->buffer.length() - this->offset;
+}
+
+bool Channel::wait(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	return this->condition.wait_for(lock, timeout, [this]() { return this->offset < this->buffer.length() || this->closed; });
+}
+
+void Channel::setNotifier(const Notifier& notifier)
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	this->notifier = notifier;
+}
+
+void Channel::close()
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	if (this->closed)
+	{
+		return;
+	}
+
+	this->closed = true;
+
+	this->condition.notify_all();
+
+	if (this->notifier)
+	{
+		this->notifier();
+
+		this->notifier = Notifier();
+	}
+}
+
+bool Channel::isClosed() const
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	return this->closed;
+}
+
+const std::size_t Channel::RetainedCapacity = 64 * 1024;
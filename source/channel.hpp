@@ -0,0 +1,62 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <initializer_list>
+
+#include "string-view.hpp"
+
+class Channel
+{
+public:
+	typedef std::function<void()> Notifier;
+
+	Channel();
+
+	bool writeLine(std::initializer_list<StringView> parts);
+
+	std::size_t read(std::string& buffer, std::size_t limit);
+
+	std::size_t getSize() const;
+
+	bool wait(std::chrono::milliseconds timeout);
+
+	void setNotifier(const Notifier& notifier);
+
+	void close();
+
+	bool isClosed() const;
+
+private:
+	static const std::size_t RetainedCapacity;
+
+	mutable std::mutex mutex;
+	std::condition_variable condition;
+
+	std::string buffer;
+	std::size_t offset;
+
+	bool closed;
+
+	Notifier notifier;
+};
@@ -16,8 +16,9 @@
  */
 
 #include "client.hpp"
+#include "server.hpp"
 
-Client::Client(const std::string& name, const std::string& address)
+Client::Client(const std::string& name, const std::string& address) : name(name), address(address), sequence(0), local(false), closing(false), reconnecting(false), awaitingSession(false), attempt(0), random(std::random_device()()), nextOffer(1)
 {
 	this->tcpSocket.connect(address);
 
@@ -28,14 +29,36 @@ Client::Client(const std::string& name, const std::string& address)
 	this->thread = std::thread([this]() { this->processNetwork(); });
 }
 
+Client::Client(const std::string& name, Server& server, const std::string& address) : name(name), address(address), sequence(0), local(true), closing(false), reconnecting(false), awaitingSession(false), attempt(0), random(std::random_device()()), nextOffer(1)
+{
+	server.connectLocal(this->tcpSocket);
+
+	this->sendMessage(name);
+
+	this->run = true;
+
+	this->thread = std::thread([this]() { this->processNetwork(); });
+}
+
 Client::~Client()
 {
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+		this->tcpSocket.writeCmd('q');
+	}
+
 	this->run = false;
 
 	if (this->thread.joinable())
 	{
 		this->thread.join();
 	}
+
+	for (auto& transfer : this->transfers)
+	{
+		transfer->thread.join();
+	}
 }
 
 bool Client::isClosed() const
@@ -70,49 +93,595 @@ void Client::sendMessage(const std::string& message)
 {
 	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
-	this->tcpSocket.writeLine(message);
+	std::string line = message;
+
+	std::replace(line.begin(), line.end(), '\n', '\v');
+
+	if (this->reconnecting || this->awaitingSession)
+	{
+		this->outbox.push(line);
+	}
+	else
+	{
+		this->tcpSocket.writeLine(line);
+	}
 }
 
-void Client::processMessage(const std::string& line)
+void Client::sendFile(const std::string& path)
 {
+	std::FILE* file = std::fopen(path.c_str(), "rb");
+
+	if (file == nullptr)
+	{
+		this->deliver("Failed to open " + path);
+
+		return;
+	}
+
+	std::string name = Transfer::getFileName(path);
+
+	unsigned long long size = Transfer::getFileSize(file);
+
 	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
-	if (line.length() > 0)
+	if (!this->startTransfer([this, file, name, size]() { this->upload(file, name, size); }))
 	{
-		this->messages.push(line);
+		std::fclose(file);
+
+		return;
 	}
+
+	this->deliver("Sending " + name + " (" + std::to_string(size) + " bytes) ...");
 }
 
-void Client::processNetwork()
+void Client::acceptFile(const std::string& offer)
 {
-	while (this->run)
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	std::map<std::string, Offer>::iterator iter = this->offers.find(offer);
+
+	if (iter == this->offers.end())
+	{
+		this->deliver("There is no file offer " + offer);
+
+		return;
+	}
+
+	Offer accepted = iter->second;
+
+	if (this->startTransfer([this, accepted]() { this->download(accepted.id, accepted.name, accepted.size); }))
+	{
+		this->offers.erase(iter);
+
+		this->deliver("Receiving " + accepted.name + " ...");
+	}
+}
+
+void Client::setMessageHandler(const MessageHandler& messageHandler)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	this->messageHandler = messageHandler;
+
+	if (this->messageHandler)
 	{
+		while (this->messages.size() > 0)
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+			this->messageHandler(this->messages.front());
+
+			this->messages.pop();
+		}
+	}
+}
+
+void Client::setDisconnectHandler(const DisconnectHandler& disconnectHandler)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	this->disconnectHandler = disconnectHandler;
+}
+
+void Client::deliver(const std::string& message)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (this->messageHandler)
+	{
+		this->messageHandler(message);
+	}
+	else
+	{
+		this->messages.push(message);
+	}
+}
+
+void Client::reconnect()
+{
+	std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+	if (now < this->nextAttempt)
+	{
+		return;
+	}
+
+	TcpSocket tcpSocket;
+
+	try
+	{
+		tcpSocket.connect(this->address);
+
+		std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+		this->tcpSocket.attach(tcpSocket.release());
+
+		this->tcpSocket.writeCmd('r', this->token + " " + std::to_string(this->sequence));
+
+		this->reconnecting = false;
+
+		this->awaitingSession = true;
+
+		this->deliver("Reconnected");
+	}
+	catch (const std::runtime_error&)
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+		this->attempt++;
+
+		if (std::chrono::steady_clock::now() - this->reconnectStart >= ReconnectTimeout)
+		{
+			this->processDisconnect("Connection has been lost");
+		}
+		else
+		{
+			this->nextAttempt = std::chrono::steady_clock::now() + this->getReconnectDelay();
+		}
+	}
+}
+
+std::chrono::milliseconds Client::getReconnectDelay()
+{
+	long long delay = std::min(ReconnectMaximumDelay.count(), ReconnectDelay.count() << std::min(this->attempt, 16u));
+
+	std::uniform_int_distribution<long long> distribution(delay / 2, delay);
+
+	return std::chrono::milliseconds(distribution(this->random));
+}
+
+void Client::upload(std::FILE* file, const std::string& name, unsigned long long size)
+{
+	unsigned long long offset = 0;
+
+	std::string reason;
+
+	try
+	{
+		std::string token;
+
+		while (this->run && token.empty())
+		{
+			{
+				std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+				if (!this->reconnecting && !this->awaitingSession)
+				{
+					token = this->token;
+				}
+			}
+
+			if (token.empty())
+			{
+				std::this_thread::sleep_for(TransferWait);
+			}
+		}
+
+		TcpSocket tcpSocket;
+
+		tcpSocket.connect(this->address);
+
+		tcpSocket.writeCmd('u', token + " " + std::to_string(size) + " " + name);
+
+		std::string line;
+
+		while (this->run && tcpSocket.isConnected() && line.empty())
+		{
+			tcpSocket.wait(TransferWait);
+
+			tcpSocket.process();
+
+			if (tcpSocket.hasLine())
+			{
+				line = tcpSocket.readLine();
+			}
+		}
+
+		if (line.compare(0, 2, "\be") == 0)
+		{
+			reason = line.substr(2);
+		}
+
+		tcpSocket.setNonBlocking();
+
+		while (this->run && line.compare(0, 2, "\bu") == 0 && offset < size && tcpSocket.isConnected())
+		{
+			std::size_t sent = tcpSocket.sendFile(file, offset, static_cast<std::size_t>(std::min<unsigned long long>(size - offset, Transfer::Batch)));
+
+			if (sent == 0)
+			{
+				tcpSocket.wait(TransferWait, true);
+			}
+
+			offset += sent;
+		}
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+
+	}
+
+	std::fclose(file);
+
+	if (!reason.empty())
+	{
+		this->deliver("Failed to send " + name + ": " + reason);
+	}
+	else
+	{
+		this->deliver(offset == size ? "Sent " + name : "Failed to send " + name);
+	}
+}
+
+void Client::download(const std::string& id, const std::string& name, unsigned long long size)
+{
+	std::string path = name;
+
+	std::FILE* file = nullptr;
+
+	for (unsigned int i = 1; file == nullptr; i++)
+	{
+		#if defined(POSIX)
+
+		int descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+		if (descriptor != -1)
+		{
+			file = fdopen(descriptor, "wb");
+
+			if (file == nullptr)
+			{
+				::close(descriptor);
+			}
+		}
+
+		bool exists = descriptor == -1 && errno == EEXIST;
 
-			this->tcpSocket.process();
+		#else
 
-			while (this->tcpSocket.hasLine())
+		file = std::fopen(path.c_str(), "wbx");
+
+		bool exists = file == nullptr && errno == EEXIST;
+
+		#endif
+
+		if (file == nullptr && !exists)
+		{
+			this->deliver("Failed to create " + path);
+
+			return;
+		}
+
+		if (file == nullptr)
+		{
+			path = name + "." + std::to_string(i);
+		}
+	}
+
+	unsigned long long received = 0;
+
+	try
+	{
+		TcpSocket tcpSocket;
+
+		tcpSocket.connect(this->address);
+
+		tcpSocket.setNonBlocking();
+
+		tcpSocket.writeCmd('d', id);
+
+		while (this->run && received < size && tcpSocket.isConnected())
+		{
+			std::size_t result = tcpSocket.receiveFile(file, static_cast<std::size_t>(std::min<unsigned long long>(size - received, Transfer::Batch)));
+
+			if (result == 0)
 			{
-				this->processMessage(this->tcpSocket.readLine());
+				tcpSocket.wait(TransferWait);
 			}
 
-			if (this->tcpSocket.hasTimedOut())
+			received += result;
+		}
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+
+	}
+
+	std::fclose(file);
+
+	this->deliver(received == size ? "Received " + name + " as " + path : "Failed to receive " + name);
+}
+
+bool Client::startTransfer(const std::function<void()>& task)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	std::vector<std::unique_ptr<Job>>::iterator iter;
+
+	for (iter = this->transfers.begin(); iter != this->transfers.end(); )
+	{
+		if ((*iter)->done)
+		{
+			(*iter)->thread.join();
+
+			iter = this->transfers.erase(iter);
+
+			continue;
+		}
+
+		iter++;
+	}
+
+	if (this->transfers.size() >= MaxTransfers)
+	{
+		this->deliver("Too many file transfers in progress, try again later");
+
+		return false;
+	}
+
+	std::unique_ptr<Job> job(new Job());
+
+	Job* pointer = job.get();
+
+	pointer->done = false;
+
+	pointer->thread = std::thread([pointer, task]()
+	{
+		task();
+
+		pointer->done = true;
+	});
+
+	this->transfers.push_back(std::move(job));
+
+	return true;
+}
+
+void Client::processCmd(const std::string& line)
+{
+	switch (line[1])
+	{
+	case 's':
+	{
+		std::stringstream stream(line.substr(2));
+
+		std::string token;
+		unsigned long long sequence = 0;
+
+		stream >> token >> sequence;
+
+		if (!stream.fail())
+		{
+			if (this->awaitingSession)
 			{
-				this->messages.push("Connection has been lost");
+				if (sequence > this->sequence)
+				{
+					this->deliver(std::to_string(sequence - this->sequence) + " messages could not be recovered");
+				}
 
-				this->tcpSocket.close();
+				this->awaitingSession = false;
 
-				this->run = false;
+				while (this->outbox.size() > 0)
+				{
+					this->tcpSocket.writeLine(this->outbox.front());
+
+					this->outbox.pop();
+				}
 			}
-			else if (!this->tcpSocket.isConnected())
+
+			this->token = token;
+			this->sequence = sequence;
+		}
+
+		break;
+	}
+	case 'n':
+	{
+		this->token.clear();
+
+		this->sequence = 0;
+
+		this->streams.clear();
+
+		this->tcpSocket.writeLine(this->name);
+
+		break;
+	}
+	case 'c':
+	{
+		this->closing = true;
+
+		break;
+	}
+	case 't':
+	{
+		this->deliver("You are sending too fast, some of your messages were dropped");
+
+		break;
+	}
+	case 'o':
+	{
+		std::stringstream stream(line.substr(2));
+
+		std::string id;
+		unsigned long long size = 0;
+		std::string name;
+		std::string sender;
+
+		stream >> id >> size >> name >> std::ws;
+
+		std::getline(stream, sender);
+
+		if (!name.empty())
+		{
+			Offer offer;
+
+			offer.id = id;
+			offer.name = Transfer::getFileName(name);
+			offer.size = size;
+
+			std::string number = std::to_string(this->nextOffer++);
+
+			this->offers[number] = offer;
+
+			this->deliver(sender + " is sending " + offer.name + " (" + std::to_string(size) + " bytes), type /accept " + number + " to download it");
+		}
+
+		break;
+	}
+	case 'k':
+	case 'K':
+	{
+		std::size_t space = line.find(' ', 2);
+
+		if (space == std::string::npos)
+		{
+			break;
+		}
+
+		std::string id = line.substr(2, space - 2);
+
+		std::string& message = this->streams[id];
+
+		message.append(line, space + 1, std::string::npos);
+
+		this->sequence++;
+
+		if (line[1] == 'K')
+		{
+			std::replace(message.begin(), message.end(), '\v', '\n');
+
+			this->deliver(message);
+
+			this->streams.erase(id);
+		}
+
+		break;
+	}
+	}
+}
+
+void Client::processMessage(const std::string& line)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (line.length() > 1 && line[0] == '\b')
+	{
+		this->processCmd(line);
+	}
+	else if (line.length() > 0)
+	{
+		std::string message = line;
+
+		std::replace(message.begin(), message.end(), '\v', '\n');
+
+		this->sequence++;
+
+		this->deliver(message);
+	}
+}
+
+void Client::processDisconnect(const std::string& reason)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (this->disconnectHandler)
+	{
+		this->disconnectHandler(reason);
+	}
+	else
+	{
+		this->messages.push(reason);
+	}
+
+	this->run = false;
+}
+
+void Client::processNetwork()
+{
+	while (this->run)
+	{
+		bool reconnecting = false;
+
+		{
+			std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+			reconnecting = this->reconnecting;
+
+			if (!reconnecting)
 			{
-				this->messages.push("The server has been closed");
+				this->tcpSocket.process();
+
+				while (this->tcpSocket.hasLine())
+				{
+					this->processMessage(this->tcpSocket.readLine());
+				}
+
+				bool timedOut = this->tcpSocket.hasTimedOut();
+
+				if (timedOut || !this->tcpSocket.isConnected())
+				{
+					this->tcpSocket.close();
+
+					if (this->closing || this->token.empty() || this->local)
+					{
+						this->processDisconnect(timedOut ? "Connection has been lost" : "The server has been closed");
+					}
+					else
+					{
+						this->reconnecting = true;
 
-				this->run = false;
+						this->attempt = 0;
+
+						this->reconnectStart = std::chrono::steady_clock::now();
+						this->nextAttempt = this->reconnectStart + this->getReconnectDelay();
+
+						this->deliver("Connection has been lost, reconnecting ...");
+					}
+				}
 			}
 		}
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		if (reconnecting)
+		{
+			this->reconnect();
+		}
+
+		if (this->tcpSocket.isConnected())
+		{
+			this->tcpSocket.wait(std::chrono::milliseconds(10));
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
 	}
 }
+
+const std::chrono::milliseconds Client::ReconnectDelay(100);
+
+const std::chrono::milliseconds Client::ReconnectMaximumDelay(5000);
+
+const std::chrono::seconds Client::ReconnectTimeout(30);
+
+const std::chrono::milliseconds Client::TransferWait(100);
+
+const std::size_t Client::MaxTransfers = 4;
@@ -21,14 +21,28 @@
 #include <mutex>
 #include <atomic>
 #include <vector>
+#include <functional>
+#include <random>
+#include <map>
+#include <memory>
+#include <cerrno>
 
 #include "tcp-socket.hpp"
+#include "transfer.hpp"
+
+class Server;
 
 class Client
 {
 public:
+	typedef std::function<void(const std::string&)> MessageHandler;
+
+	typedef std::function<void(const std::string&)> DisconnectHandler;
+
 	Client(const std::string& name, const std::string& address);
 
+	Client(const std::string& name, Server& server, const std::string& address);
+
 	~Client();
 
 	bool isClosed() const;
@@ -39,16 +53,95 @@ public:
 
 	void sendMessage(const std::string& message);
 
+	void sendFile(const std::string& path);
+
+	void acceptFile(const std::string& offer);
+
+	void setMessageHandler(const MessageHandler& messageHandler);
+
+	void setDisconnectHandler(const DisconnectHandler& disconnectHandler);
+
 private:
+	struct Offer
+	{
+		std::string id;
+		std::string name;
+
+		unsigned long long size;
+	};
+
+	struct Job
+	{
+		std::thread thread;
+
+		std::atomic_bool done;
+	};
+
+	static const std::chrono::milliseconds ReconnectDelay;
+
+	static const std::chrono::milliseconds ReconnectMaximumDelay;
+
+	static const std::chrono::seconds ReconnectTimeout;
+
+	static const std::chrono::milliseconds TransferWait;
+
+	static const std::size_t MaxTransfers;
+
+	void deliver(const std::string& message);
+
+	void reconnect();
+
+	std::chrono::milliseconds getReconnectDelay();
+
+	void upload(std::FILE* file, const std::string& name, unsigned long long size);
+
+	void download(const std::string& id, const std::string& name, unsigned long long size);
+
+	bool startTransfer(const std::function<void()>& task);
+
+	void processCmd(const std::string& line);
+
 	void processMessage(const std::string& line);
 
+	void processDisconnect(const std::string& reason);
+
 	void processNetwork();
 
 	TcpSocket tcpSocket;
 
+	std::string name;
+	std::string address;
+
+	std::string token;
+	unsigned long long sequence;
+
+	bool local;
+	bool closing;
+	bool reconnecting;
+	bool awaitingSession;
+
+	unsigned int attempt;
+
+	std::chrono::time_point<std::chrono::steady_clock> reconnectStart;
+	std::chrono::time_point<std::chrono::steady_clock> nextAttempt;
+
+	std::mt19937 random;
+
+	std::queue<std::string> outbox;
+
 	std::queue<std::string> messages;
 
+	std::map<std::string, std::string> streams;
+
+	std::map<std::string, Offer> offers;
+	unsigned int nextOffer;
+
+	MessageHandler messageHandler;
+
+	DisconnectHandler disconnectHandler;
+
 	std::thread thread;
+	std::vector<std::unique_ptr<Job>> transfers;
 	mutable std::recursive_mutex mutex;
 
 	std::atomic_bool run;
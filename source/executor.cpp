@@ -0,0 +1,182 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "executor.hpp"
+#include "metrics.hpp"
+
+namespace
+{
+	thread_local std::size_t currentWorker = static_cast<std::size_t>(-1);
+
+	thread_local const void* currentExecutor = nullptr;
+}
+
+Executor::Executor(std::size_t workers) : next(0), pending(0), sleeping(0)
+{
+	if (workers == 0)
+	{
+		workers = getDefaultWorkerCount();
+	}
+
+	for (std::size_t i = 0; i < workers; i++)
+	{
+		this->workers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+
+	this->run = true;
+
+	for (std::size_t i = 0; i < workers; i++)
+	{
+		this->threads.push_back(std::thread([this, i]() { this->processWorker(i); }));
+	}
+}
+
+Executor::~Executor()
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+		this->run = false;
+	}
+
+	this->idle.notify_all();
+
+	for (auto& thread : this->threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+}
+
+std::size_t Executor::getWorkerCount() const
+{
+	return this->workers.size();
+}
+
+void Executor::submit(const Task& task)
+{
+	std::size_t index = currentWorker;
+
+	if (currentExecutor != this)
+	{
+		index = this->next++ % this->workers.size();
+	}
+
+	{
+		std::lock_guard<std::mutex> lockGuard(this->workers[index]->mutex);
+
+		this->workers[index]->tasks.push_back(task);
+	}
+
+	this->pending++;
+
+	if (this->sleeping > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lockGuard(this->mutex);
+		}
+
+		this->idle.notify_one();
+	}
+}
+
+std::size_t Executor::getDefaultWorkerCount()
+{
+	return std::max(std::thread::hardware_concurrency(), 2u);
+}
+
+bool Executor::pop(std::size_t index, Task& task)
+{
+	Worker& worker = *this->workers[index];
+
+	std::lock_guard<std::mutex> lockGuard(worker.mutex);
+
+	if (worker.tasks.empty())
+	{
+		return false;
+	}
+
+	std::swap(task, worker.tasks.back());
+
+	worker.tasks.pop_back();
+
+	return true;
+}
+
+bool Executor::steal(std::size_t index, Task& task)
+{
+	for (std::size_t i = 1; i < this->workers.size(); i++)
+	{
+		Worker& worker = *this->workers[(index + i) % this->workers.size()];
+
+		std::unique_lock<std::mutex> lock(worker.mutex, std::try_to_lock);
+
+		if (lock.owns_lock() && !worker.tasks.empty())
+		{
+			std::swap(task, worker.tasks.front());
+
+			worker.tasks.pop_front();
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Executor::processWorker(std::size_t index)
+{
+	currentWorker = index;
+
+	currentExecutor = this;
+
+	Task task;
+
+	while (this->run)
+	{
+		if (this->pop(index, task))
+		{
+			Metrics::count(Metrics::TasksExecuted);
+		}
+		else if (this->steal(index, task))
+		{
+			Metrics::count(Metrics::TasksExecuted);
+
+			Metrics::count(Metrics::TasksStolen);
+		}
+		else
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+
+			this->sleeping++;
+
+			this->idle.wait(lock, [this]() { return !this->run || this->pending > 0; });
+
+			this->sleeping--;
+
+			continue;
+		}
+
+		this->pending--;
+
+		task();
+
+		task = nullptr;
+	}
+}
@@ -0,0 +1,72 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+class Executor
+{
+public:
+	typedef std::function<void()> Task;
+
+	Executor(std::size_t workers = 0);
+
+	~Executor();
+
+	std::size_t getWorkerCount() const;
+
+	void submit(const Task& task);
+
+	static std::size_t getDefaultWorkerCount();
+
+private:
+	struct Worker
+	{
+		std::deque<Task> tasks;
+
+		std::mutex mutex;
+	};
+
+	bool pop(std::size_t index, Task& task);
+
+	bool steal(std::size_t index, Task& task);
+
+	void processWorker(std::size_t index);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::vector<std::thread> threads;
+
+	std::atomic<std::size_t> next;
+	std::atomic<std::size_t> pending;
+	std::atomic<std::size_t> sleeping;
+
+	std::mutex mutex;
+	std::condition_variable idle;
+
+	std::atomic_bool run;
+};
@@ -0,0 +1,505 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "handoff.hpp"
+
+Handoff::Handoff() : socket(INVALID_SOCKET), offset(0), socketIndex(0)
+{
+
+}
+
+Handoff::~Handoff()
+{
+	this->close();
+}
+
+void Handoff::listen(const std::string& path)
+{
+	this->listener.bind(path);
+
+	#if defined(POSIX)
+
+	if (chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0)
+	{
+		this->listener.close();
+
+		throw std::runtime_error("Failed to restrict access to the control socket " + path);
+	}
+
+	#endif
+
+	this->listener.listen(1);
+}
+
+bool Handoff::accept()
+{
+	TcpSocket connection;
+
+	if (!this->listener.accept(connection))
+	{
+		return false;
+	}
+
+	this->disconnect();
+
+	this->socket = connection.release();
+
+	this->setup(HelloTimeout);
+
+	try
+	{
+		if (!this->isSameUser())
+		{
+			throw std::runtime_error("The handoff peer belongs to another user");
+		}
+
+		Hello hello;
+
+		this->receiveAll(reinterpret_cast<char*>(&hello), sizeof(hello));
+
+		if (hello.magic != Magic || hello.version != Version)
+		{
+			throw std::runtime_error("Unexpected handoff hello");
+		}
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		this->disconnect();
+
+		return false;
+	}
+
+	this->setup(Timeout);
+
+	return true;
+}
+
+bool Handoff::connect(const std::string& path)
+{
+	TcpSocket connection;
+
+	try
+	{
+		connection.connect(Network::UnixPrefix + path);
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		return false;
+	}
+
+	this->disconnect();
+
+	this->socket = connection.release();
+
+	this->setup(Timeout);
+
+	try
+	{
+		if (!this->isSameUser())
+		{
+			throw std::runtime_error("The handoff peer belongs to another user");
+		}
+
+		Hello hello;
+
+		hello.magic = Magic;
+		hello.version = Version;
+
+		this->sendAll(reinterpret_cast<const char*>(&hello), sizeof(hello));
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		this->disconnect();
+
+		return false;
+	}
+
+	return true;
+}
+
+bool Handoff::isConnected() const
+{
+	return this->socket != INVALID_SOCKET;
+}
+
+void Handoff::writeNumber(unsigned long long value)
+{
+	while (value >= 0x80)
+	{
+		this->buffer += static_cast<char>((value & 0x7f) | 0x80);
+
+		value >>= 7;
+	}
+
+	this->buffer += static_cast<char>(value);
+}
+
+void Handoff::writeReal(double value)
+{
+	unsigned long long bits = 0;
+
+	std::memcpy(&bits, &value, sizeof(value));
+
+	this->writeNumber(bits);
+}
+
+void Handoff::writeString(const StringView& value)
+{
+	this->writeNumber(value.length);
+
+	this->buffer.append(value.data, value.length);
+}
+
+void Handoff::writeSocket(Socket socket)
+{
+	this->sockets.push_back(socket);
+}
+
+void Handoff::send()
+{
+	#if defined(POSIX)
+
+	std::vector<char> control(CMSG_SPACE(sizeof(int) * MaxSockets));
+
+	std::size_t sent = 0;
+
+	do
+	{
+		std::size_t count = std::min(MaxSockets, this->sockets.size() - sent);
+
+		Header header;
+
+		header.magic = Magic;
+		header.sockets = count;
+		header.remaining = this->sockets.size() - sent - count;
+		header.length = this->buffer.length();
+
+		iovec vector;
+
+		vector.iov_base = &header;
+		vector.iov_len = sizeof(header);
+
+		msghdr message;
+
+		std::memset(&message, 0, sizeof(message));
+
+		message.msg_iov = &vector;
+		message.msg_iovlen = 1;
+
+		if (count > 0)
+		{
+			message.msg_control = control.data();
+			message.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+			cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+
+			std::memcpy(CMSG_DATA(cmsg), this->sockets.data() + sent, sizeof(int) * count);
+		}
+
+		if (sendmsg(this->socket, &message, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(header)))
+		{
+			throw std::runtime_error("Failed to send the handoff state");
+		}
+
+		sent += count;
+	}
+	while (sent < this->sockets.size());
+
+	this->sendAll(this->buffer.data(), this->buffer.length());
+
+	this->buffer.clear();
+
+	this->sockets.clear();
+
+	#else
+
+	throw std::runtime_error("Hot restart is not supported on this platform");
+
+	#endif
+}
+
+void Handoff::receive()
+{
+	#if defined(POSIX)
+
+	std::vector<char> control(CMSG_SPACE(sizeof(int) * MaxSockets));
+
+	Header header;
+
+	do
+	{
+		iovec vector;
+
+		vector.iov_base = &header;
+		vector.iov_len = sizeof(header);
+
+		msghdr message;
+
+		std::memset(&message, 0, sizeof(message));
+
+		message.msg_iov = &vector;
+		message.msg_iovlen = 1;
+		message.msg_control = control.data();
+		message.msg_controllen = control.size();
+
+		#if defined(MSG_CMSG_CLOEXEC)
+
+		ssize_t received = recvmsg(this->socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+
+		#else
+
+		ssize_t received = recvmsg(this->socket, &message, MSG_WAITALL);
+
+		#endif
+
+		std::size_t count = this->sockets.size();
+
+		if (received > 0)
+		{
+			for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+				{
+					std::size_t length = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+					this->sockets.resize(this->sockets.size() + length);
+
+					std::memcpy(&this->sockets[this->sockets.size() - length], CMSG_DATA(cmsg), sizeof(int) * length);
+				}
+			}
+		}
+
+		count = this->sockets.size() - count;
+
+		if (received != static_cast<ssize_t>(sizeof(header)) || (message.msg_flags & MSG_CTRUNC) != 0 || header.magic != Magic || header.sockets != count || header.length > MaxLength)
+		{
+			throw std::runtime_error("Failed to receive the handoff state");
+		}
+	}
+	while (header.remaining > 0);
+
+	this->buffer.resize(static_cast<std::size_t>(header.length));
+
+	this->offset = 0;
+
+	if (header.length > 0)
+	{
+		this->receiveAll(&this->buffer[0], this->buffer.length());
+	}
+
+	#else
+
+	throw std::runtime_error("Hot restart is not supported on this platform");
+
+	#endif
+}
+
+unsigned long long Handoff::readNumber()
+{
+	unsigned long long value = 0;
+
+	for (unsigned int shift = 0; shift < 64 && this->offset < this->buffer.length(); shift += 7)
+	{
+		unsigned char byte = static_cast<unsigned char>(this->buffer[this->offset++]);
+
+		value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+
+		if ((byte & 0x80) == 0)
+		{
+			return value;
+		}
+	}
+
+	throw std::runtime_error("Malformed handoff state");
+}
+
+double Handoff::readReal()
+{
+	unsigned long long bits = this->readNumber();
+
+	double value = 0.0;
+
+	std::memcpy(&value, &bits, sizeof(value));
+
+	return value;
+}
+
+std::string Handoff::readString()
+{
+	unsigned long long length = this->readNumber();
+
+	if (length > this->buffer.length() - this->offset)
+	{
+		throw std::runtime_error("Malformed handoff state");
+	}
+
+	std::string value(this->buffer, this->offset, static_cast<std::size_t>(length));
+
+	this->offset += static_cast<std::size_t>(length);
+
+	return value;
+}
+
+Socket Handoff::readSocket()
+{
+	if (this->socketIndex >= this->sockets.size())
+	{
+		throw std::runtime_error("Malformed handoff state");
+	}
+
+	return this->sockets[this->socketIndex++];
+}
+
+void Handoff::acknowledge()
+{
+	char byte = 'a';
+
+	this->sendAll(&byte, 1);
+
+	while (recv(this->socket, &byte, 1, 0) > 0)
+	{
+
+	}
+
+	this->disconnect();
+}
+
+bool Handoff::isAcknowledged()
+{
+	char byte = 0;
+
+	return recv(this->socket, &byte, 1, 0) == 1 && byte == 'a';
+}
+
+void Handoff::disconnect()
+{
+	if (this->socket != INVALID_SOCKET)
+	{
+		::close(this->socket);
+
+		this->socket = INVALID_SOCKET;
+	}
+
+	for (std::size_t i = this->socketIndex; i < this->sockets.size(); i++)
+	{
+		::close(this->sockets[i]);
+	}
+
+	this->sockets.clear();
+
+	this->socketIndex = 0;
+
+	this->buffer.clear();
+
+	this->offset = 0;
+}
+
+void Handoff::close()
+{
+	this->listener.close();
+
+	this->disconnect();
+}
+
+void Handoff::setup(std::chrono::milliseconds timeout)
+{
+	Network::setNonBlocking(this->socket, false);
+
+	#if defined(POSIX)
+
+	timeval tv;
+	tv.tv_sec = static_cast<long>(timeout.count() / 1000);
+	tv.tv_usec = static_cast<long>((timeout.count() % 1000) * 1000);
+
+	setsockopt(this->socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(this->socket, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	#endif
+}
+
+bool Handoff::isSameUser() const
+{
+	#if defined(SO_PEERCRED)
+
+	ucred credentials;
+	socklen_t length = sizeof(credentials);
+
+	return getsockopt(this->socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length) == 0 && credentials.uid == getuid();
+
+	#elif defined(POSIX)
+
+	uid_t uid;
+	gid_t gid;
+
+	return getpeereid(this->socket, &uid, &gid) == 0 && uid == getuid();
+
+	#else
+
+	return false;
+
+	#endif
+}
+
+void Handoff::sendAll(const char* data, std::size_t length)
+{
+	while (length > 0)
+	{
+		int sent = ::send(this->socket, data, static_cast<int>(std::min<std::size_t>(length, 1024 * 1024)), MSG_NOSIGNAL);
+
+		if (sent <= 0)
+		{
+			throw std::runtime_error("Failed to send the handoff state");
+		}
+
+		data += sent;
+
+		length -= static_cast<std::size_t>(sent);
+	}
+}
+
+void Handoff::receiveAll(char* data, std::size_t length)
+{
+	while (length > 0)
+	{
+		int received = recv(this->socket, data, static_cast<int>(std::min<std::size_t>(length, 1024 * 1024)), 0);
+
+		if (received <= 0)
+		{
+			throw std::runtime_error("Failed to receive the handoff state");
+		}
+
+		data += received;
+
+		length -= static_cast<std::size_t>(received);
+	}
+}
+
+const unsigned long long Handoff::Magic = 0x3146484354ull;
+
+const unsigned long long Handoff::Version = 1;
+
+const std::size_t Handoff::MaxSockets = 250;
+
+const unsigned long long Handoff::MaxLength = 1024ull * 1024 * 1024;
+
+const std::chrono::milliseconds Handoff::Timeout(10000);
+
+const std::chrono::milliseconds Handoff::HelloTimeout(1000);
@@ -0,0 +1,115 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "network.hpp"
+#include "string-view.hpp"
+#include "tcp-socket.hpp"
+
+class Handoff
+{
+public:
+	Handoff();
+
+	~Handoff();
+
+	void listen(const std::string& path);
+
+	bool accept();
+
+	bool connect(const std::string& path);
+
+	bool isConnected() const;
+
+	void writeNumber(unsigned long long value);
+
+	void writeReal(double value);
+
+	void writeString(const StringView& value);
+
+	void writeSocket(Socket socket);
+
+	void send();
+
+	void receive();
+
+	unsigned long long readNumber();
+
+	double readReal();
+
+	std::string readString();
+
+	Socket readSocket();
+
+	void acknowledge();
+
+	bool isAcknowledged();
+
+	void disconnect();
+
+	void close();
+
+private:
+	struct Header
+	{
+		unsigned long long magic;
+		unsigned long long sockets;
+		unsigned long long remaining;
+		unsigned long long length;
+	};
+
+	struct Hello
+	{
+		unsigned long long magic;
+		unsigned long long version;
+	};
+
+	void setup(std::chrono::milliseconds timeout);
+
+	bool isSameUser() const;
+
+	void sendAll(const char* data, std::size_t length);
+
+	void receiveAll(char* data, std::size_t length);
+
+	static const unsigned long long Magic;
+
+	static const unsigned long long Version;
+
+	static const std::size_t MaxSockets;
+
+	static const unsigned long long MaxLength;
+
+	static const std::chrono::milliseconds Timeout;
+
+	static const std::chrono::milliseconds HelloTimeout;
+
+	TcpSocket listener;
+
+	Socket socket;
+
+	std::string buffer;
+	std::size_t offset;
+
+	std::vector<Socket> sockets;
+	std::size_t socketIndex;
+};
@@ -0,0 +1,131 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "history.hpp"
+
+History::History(std::size_t maxBytes, std::size_t maxLines) : arena(std::max<std::size_t>(maxBytes, 2)), entries(std::max<std::size_t>(maxLines, 1)), first(0), count(0), tail(0)
+{
+
+}
+
+bool History::isEmpty() const
+{
+	return this->count == 0;
+}
+
+std::size_t History::size() const
+{
+	return this->count;
+}
+
+std::string History::get(std::size_t index) const
+{
+	if (index < this->count)
+	{
+		const Entry& entry = this->entry(index);
+
+		return std::string(this->arena.data() + entry.offset, entry.length);
+	}
+
+	return "";
+}
+
+void History::push(const std::string& line)
+{
+	this->push({ StringView(line) });
+}
+
+void History::push(std::initializer_list<StringView> parts)
+{
+	std::size_t length = 0;
+
+	for (const StringView& part : parts)
+	{
+		length += part.length;
+	}
+
+	// Entries carry a separator byte, so everything from the tail onwards is older
+	length = std::min(length, this->arena.size() - 1);
+
+	if (this->count == this->entries.size())
+	{
+		this->pop();
+	}
+
+	if (this->tail + length + 1 > this->arena.size())
+	{
+		while (this->count > 0 && this->entry(0).offset >= this->tail)
+		{
+			this->pop();
+		}
+
+		this->tail = 0;
+	}
+
+	while (this->count > 0 && this->entry(0).offset >= this->tail && this->entry(0).offset < this->tail + length + 1)
+	{
+		this->pop();
+	}
+
+	std::size_t position = this->tail;
+
+	for (const StringView& part : parts)
+	{
+		std::size_t size = std::min(part.length, this->tail + length - position);
+
+		std::memcpy(this->arena.data() + position, part.data, size);
+
+		position += size;
+	}
+
+	this->arena[this->tail + length] = '\0';
+
+	Entry& entry = this->entries[(this->first + this->count) % this->entries.size()];
+
+	entry.offset = this->tail;
+	entry.length = length;
+
+	this->count++;
+
+	this->tail += length + 1;
+}
+
+void History::clear()
+{
+	this->first = 0;
+	this->count = 0;
+	this->tail = 0;
+}
+
+const History::Entry& History::entry(std::size_t index) const
+{
+	return this->entries[(this->first + index) % this->entries.size()];
+}
+
+void History::pop()
+{
+	if (this->count > 0)
+	{
+		this->first = (this->first + 1) % this->entries.size();
+
+		this->count--;
+	}
+}
+
+const std::size_t History::DefaultBytes = 4 * 1024 * 1024;
+
+const std::size_t History::DefaultLines = 64 * 1024;
@@ -0,0 +1,67 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+
+#include "string-view.hpp"
+
+class History
+{
+public:
+	History(std::size_t maxBytes = DefaultBytes, std::size_t maxLines = DefaultLines);
+
+	bool isEmpty() const;
+
+	std::size_t size() const;
+
+	std::string get(std::size_t index) const;
+
+	void push(const std::string& line);
+
+	void push(std::initializer_list<StringView> parts);
+
+	void clear();
+
+	static const std::size_t DefaultBytes;
+
+	static const std::size_t DefaultLines;
+
+private:
+	struct Entry
+	{
+		std::size_t offset;
+		std::size_t length;
+	};
+
+	const Entry& entry(std::size_t index) const;
+
+	void pop();
+
+	std::vector<char> arena;
+	std::vector<Entry> entries;
+
+	std::size_t first;
+	std::size_t count;
+	std::size_t tail;
+};
@@ -0,0 +1,100 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "metrics.hpp"
+
+void Metrics::count(Counter counter, unsigned long long n)
+{
+	counters[counter] += n;
+}
+
+void Metrics::countError(const std::string& operation, int error)
+{
+	std::lock_guard<std::mutex> lockGuard(mutex);
+
+	errors[std::pair<std::string, int>(operation, error)]++;
+}
+
+void Metrics::set(Counter counter, unsigned long long value)
+{
+	counters[counter] = value;
+}
+
+unsigned long long Metrics::get(Counter counter)
+{
+	return counters[counter];
+}
+
+std::string Metrics::report()
+{
+	std::lock_guard<std::mutex> lockGuard(mutex);
+
+	std::stringstream stream;
+
+	for (int i = 0; i < CounterCount; i++)
+	{
+		stream << names[i] << ": " << counters[i] << "\n";
+	}
+
+	for (auto& error : errors)
+	{
+		stream << error.first.first << " error " << error.first.second << " (" << std::strerror(error.first.second) << "): " << error.second << "\n";
+	}
+
+	std::string str = stream.str();
+
+	if (str.length() > 0)
+	{
+		str.resize(str.length() - 1);
+	}
+
+	return str;
+}
+
+const char* Metrics::names[CounterCount] =
+{
+	"accepted connections",
+	"accept failures",
+	"shed connections",
+	"heartbeats sent",
+	"heartbeats received",
+	"lines sent",
+	"lines received",
+	"relayed messages",
+	"duplicate messages",
+	"ingress queue depth",
+	"egress queue depth",
+	"ingress latency (us)",
+	"tasks executed",
+	"tasks stolen",
+	"sanitized lines",
+	"throttled lines",
+	"dropped lines",
+	"flood disconnects",
+	"oversized lines",
+	"streamed chunks",
+	"send overflows",
+	"transferred bytes",
+	"failed transfers",
+	"rejected peers"
+};
+
+std::atomic<unsigned long long> Metrics::counters[CounterCount];
+
+std::map<std::pair<std::string, int>, unsigned long long> Metrics::errors;
+
+std::mutex Metrics::mutex;
@@ -0,0 +1,77 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <string>
+#include <sstream>
+#include <cstring>
+
+class Metrics
+{
+public:
+	enum Counter
+	{
+		AcceptedConnections,
+		AcceptFailures,
+		ShedConnections,
+		HeartbeatsSent,
+		HeartbeatsReceived,
+		LinesSent,
+		LinesReceived,
+		RelayedMessages,
+		DuplicateMessages,
+		IngressQueueDepth,
+		EgressQueueDepth,
+		IngressLatency,
+		TasksExecuted,
+		TasksStolen,
+		SanitizedLines,
+		ThrottledLines,
+		DroppedLines,
+		FloodDisconnects,
+		OversizedLines,
+		StreamedChunks,
+		SendOverflows,
+		TransferredBytes,
+		FailedTransfers,
+		RejectedPeers,
+		CounterCount
+	};
+
+	static void count(Counter counter, unsigned long long n = 1);
+
+	static void set(Counter counter, unsigned long long value);
+
+	static void countError(const std::string& operation, int error);
+
+	static unsigned long long get(Counter counter);
+
+	static std::string report();
+
+private:
+	static const char* names[CounterCount];
+
+	static std::atomic<unsigned long long> counters[CounterCount];
+
+	static std::map<std::pair<std::string, int>, unsigned long long> errors;
+
+	static std::mutex mutex;
+};
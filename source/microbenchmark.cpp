@@ -0,0 +1,468 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <new>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+#include "arguments.hpp"
+#include "network.hpp"
+#include "terminal.hpp"
+#include "tcp-socket.hpp"
+
+std::string msgHelp =
+"microbenchmark:\n"
+"Run: [-filter [name]] [-samples [count=20]] [-p [port=47200]] [-csv]";
+
+std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+	allocations++;
+
+	void* pointer = std::malloc(size > 0 ? size : 1);
+
+	if (!pointer)
+	{
+		throw std::bad_alloc();
+	}
+
+	return pointer;
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+volatile std::size_t sink = 0;
+
+struct Result
+{
+	std::string name;
+
+	std::size_t samples;
+	unsigned long long iterations;
+
+	double minimum;
+	double median;
+	double mean;
+	double maximum;
+	double deviation;
+
+	double allocations;
+};
+
+const std::chrono::milliseconds SampleTime(10);
+
+const std::chrono::milliseconds WarmUpTime(200);
+
+template<typename Operation>
+double runBatch(Operation& operation, unsigned long long iterations)
+{
+	std::size_t result = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (unsigned long long i = 0; i < iterations; i++)
+	{
+		result += operation();
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	sink = sink + result;
+
+	return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+template<typename Operation>
+Result measure(const std::string& name, std::size_t samples, Operation operation)
+{
+	unsigned long long iterations = 1;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	while (std::chrono::steady_clock::now() - start < WarmUpTime)
+	{
+		if (runBatch(operation, iterations) < std::chrono::duration<double, std::nano>(SampleTime).count())
+		{
+			iterations *= 2;
+		}
+	}
+
+	std::vector<double> durations;
+
+	durations.reserve(samples);
+
+	unsigned long long allocated = allocations;
+
+	for (std::size_t i = 0; i < samples; i++)
+	{
+		durations.push_back(runBatch(operation, iterations) / static_cast<double>(iterations));
+	}
+
+	allocated = allocations - allocated;
+
+	std::sort(durations.begin(), durations.end());
+
+	Result result;
+
+	result.name = name;
+	result.samples = samples;
+	result.iterations = iterations;
+
+	result.minimum = durations.front();
+	result.median = durations[durations.size() / 2];
+	result.maximum = durations.back();
+
+	result.mean = 0.0;
+
+	for (double duration : durations)
+	{
+		result.mean += duration / static_cast<double>(samples);
+	}
+
+	result.deviation = 0.0;
+
+	for (double duration : durations)
+	{
+		result.deviation += (duration - result.mean) * (duration - result.mean) / static_cast<double>(std::max<std::size_t>(samples - 1, 1));
+	}
+
+	result.deviation = std::sqrt(result.deviation);
+
+	result.allocations = static_cast<double>(allocated) / static_cast<double>(samples * iterations);
+
+	return result;
+}
+
+void print(const Result& result, bool csv)
+{
+	if (csv)
+	{
+		std::cout << result.name << "," << result.samples << "," << result.iterations << "," << result.minimum << "," << result.median << ","
+			<< result.mean << "," << result.maximum << "," << result.deviation << "," << result.allocations << std::endl;
+	}
+	else
+	{
+		std::cout << std::left << std::setw(32) << result.name + ":" << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(10) << result.median << " ns/op (min " << result.minimum << ", max " << result.maximum << ", stddev " << result.deviation
+			<< ", " << result.samples << " x " << result.iterations << "), " << std::setprecision(2) << result.allocations << " allocations/op"
+			<< std::defaultfloat << std::endl;
+	}
+}
+
+std::pair<std::string, unsigned short> splitAddressReference(const std::string& address)
+{
+	std::string ipAddress = address;
+	unsigned short port = Network::DefaultPort;
+
+	std::size_t pos = address.find('[');
+
+	if (pos == 0)
+	{
+		pos = address.find(']');
+
+		if (pos != std::string::npos)
+		{
+			ipAddress = std::string(address.begin() + 1, address.begin() + pos);
+
+			std::string portStr = std::string(address.begin() + pos + 1, address.end());
+
+			pos = portStr.rfind(':');
+
+			if (pos == 0)
+			{
+				portStr = std::string(portStr.begin() + 1, portStr.end());
+
+				std::stringstream stream(portStr);
+
+				stream >> port;
+			}
+		}
+	}
+	else
+	{
+		pos = address.rfind(':');
+
+		if (pos != std::string::npos && address.find(':') == address.rfind(':'))
+		{
+			ipAddress = std::string(address.begin(), address.begin() + pos);
+
+			std::string portStr = std::string(address.begin() + pos + 1, address.end());
+
+			std::stringstream stream(portStr);
+
+			stream >> port;
+		}
+	}
+
+	return std::pair<std::string, unsigned short>(ipAddress, port);
+}
+
+std::string unmapIPv4Reference(const std::string& address)
+{
+	std::size_t pos = address.find("::ffff:");
+
+	if (pos == 0)
+	{
+		std::string ipv4Address(address.begin() + 7, address.end());
+
+		pos = ipv4Address.find(':');
+
+		std::size_t posDot = ipv4Address.find('.');
+
+		if (pos == std::string::npos && posDot != std::string::npos)
+		{
+			return ipv4Address;
+		}
+	}
+
+	return address;
+}
+
+bool verifyAddresses(const std::vector<std::string>& addresses)
+{
+	bool identical = true;
+
+	for (const std::string& address : addresses)
+	{
+		std::pair<std::string, unsigned short> reference = splitAddressReference(address);
+
+		unsigned short port = 0;
+
+		StringView ipAddress = Network::splitAddress(StringView(address), port);
+
+		if (Network::splitAddress(address) != reference || ipAddress.str() != reference.first || port != reference.second)
+		{
+			std::cerr << "splitAddress differs for \"" << address << "\"" << std::endl;
+
+			identical = false;
+		}
+
+		if (Network::unmapIPv4(address) != unmapIPv4Reference(address) || Network::unmapIPv4(StringView(address)).str() != unmapIPv4Reference(address))
+		{
+			std::cerr << "unmapIPv4 differs for \"" << address << "\"" << std::endl;
+
+			identical = false;
+		}
+	}
+
+	return identical;
+}
+
+Result measureFraming(const std::string& name, std::size_t samples, unsigned short port, std::size_t lineLength)
+{
+	TcpSocket listener;
+
+	listener.bind(port);
+	listener.listen();
+
+	std::vector<Endpoint> endpoints = Network::resolve("127.0.0.1", port);
+
+	if (endpoints.empty())
+	{
+		throw std::runtime_error("Failed to resolve 127.0.0.1");
+	}
+
+	Socket sender = ::socket(endpoints.front().getFamily(), SOCK_STREAM, IPPROTO_TCP);
+
+	if (sender == INVALID_SOCKET || ::connect(sender, endpoints.front().getAddress(), endpoints.front().length) == SOCKET_ERROR)
+	{
+		throw std::runtime_error("Failed to connect the framing sender");
+	}
+
+	TcpSocket receiver;
+
+	while (!listener.accept(receiver))
+	{
+		listener.wait(std::chrono::milliseconds(10));
+	}
+
+	std::string block;
+
+	std::size_t lines = 32 * 1024 / (lineLength + 1);
+
+	for (std::size_t i = 0; i < lines; i++)
+	{
+		block.append(lineLength, static_cast<char>('a' + i % 26));
+
+		block += '\n';
+	}
+
+	Result result = measure(name, samples, [&]()
+	{
+		for (std::size_t sent = 0; sent < block.length();)
+		{
+			int length = send(sender, block.data() + sent, static_cast<int>(block.length() - sent), MSG_NOSIGNAL);
+
+			if (length <= 0)
+			{
+				throw std::runtime_error("Failed to send a framing block");
+			}
+
+			sent += static_cast<std::size_t>(length);
+		}
+
+		std::size_t received = 0;
+
+		StringView line;
+
+		while (received < lines && receiver.isConnected())
+		{
+			receiver.process();
+
+			while (receiver.readLine(line))
+			{
+				received++;
+			}
+		}
+
+		return received;
+	});
+
+	close(sender);
+
+	return result;
+}
+
+int main(int argc, char* argv[])
+{
+	Arguments::setArgs(argc, argv);
+
+	if (Arguments::hasFlag("help"))
+	{
+		std::cout << msgHelp << std::endl;
+
+		return 0;
+	}
+
+	std::string filter = Arguments::hasArgument("filter") ? Arguments::getArgument("filter") : "";
+
+	std::size_t samples = Arguments::hasArgument("samples") ? std::max(std::atoi(Arguments::getArgument("samples").c_str()), 1) : 20;
+
+	unsigned short port = Arguments::hasArgument("p") ? static_cast<unsigned short>(std::atoi(Arguments::getArgument("p").c_str())) : 47200;
+
+	bool csv = Arguments::hasFlag("csv");
+
+	std::vector<std::string> addresses = { "127.0.0.1", "127.0.0.1:47100", "chat.example.com:8080", "[::1]:47100", "[fe80::1%eth0]", "fe80::1",
+		"::ffff:192.168.0.1", "::ffff:10.0.0.1:80", "[::ffff:192.168.0.1]:1024" };
+
+	std::vector<std::string> edgeCases = { "", ":", "[", "[]", "[::1]", "[::1]:", "[::1]x", "[::1]:80:81", "host:", "host: 80", "host:80abc",
+		"host:abc", "host:+5", "host:-1", "host:-65535", "host:65535", "host:65536", "host:99999999999999999999", "host:\t7", "::ffff:", "::ffff:abc",
+		"x::ffff:1.2.3.4", "::FFFF:1.2.3.4" };
+
+	edgeCases.insert(edgeCases.end(), addresses.begin(), addresses.end());
+
+	if (!verifyAddresses(edgeCases))
+	{
+		return 1;
+	}
+
+	std::vector<StringView> views(addresses.begin(), addresses.end());
+
+	std::size_t index = 0;
+
+	if (csv)
+	{
+		std::cout << "name,samples,iterations,min_ns,median_ns,mean_ns,max_ns,stddev_ns,allocations_per_op" << std::endl;
+	}
+
+	auto run = [&](const std::string& name, const std::function<Result()>& benchmark)
+	{
+		if (name.find(filter) != std::string::npos)
+		{
+			print(benchmark(), csv);
+		}
+	};
+
+	run("splitAddress/stringstream", [&]() { return measure("splitAddress/stringstream", samples, [&]()
+	{
+		return static_cast<std::size_t>(splitAddressReference(addresses[index++ % addresses.size()]).second);
+	}); });
+
+	run("splitAddress/string", [&]() { return measure("splitAddress/string", samples, [&]()
+	{
+		return static_cast<std::size_t>(Network::splitAddress(addresses[index++ % addresses.size()]).second);
+	}); });
+
+	run("splitAddress/view", [&]() { return measure("splitAddress/view", samples, [&]()
+	{
+		unsigned short port = 0;
+
+		return Network::splitAddress(views[index++ % views.size()], port).length + port;
+	}); });
+
+	run("unmapIPv4/reference", [&]() { return measure("unmapIPv4/reference", samples, [&]()
+	{
+		return unmapIPv4Reference(addresses[index++ % addresses.size()]).length();
+	}); });
+
+	run("unmapIPv4/string", [&]() { return measure("unmapIPv4/string", samples, [&]()
+	{
+		return Network::unmapIPv4(addresses[index++ % addresses.size()]).length();
+	}); });
+
+	run("unmapIPv4/view", [&]() { return measure("unmapIPv4/view", samples, [&]()
+	{
+		return Network::unmapIPv4(views[index++ % views.size()]).length;
+	}); });
+
+	run("terminal/getCursorPosition", [&]() { return measure("terminal/getCursorPosition", samples, [&]()
+	{
+		std::size_t n = index++;
+
+		Coord cursorPosition = Terminal::getCursorPosition(n % 4096, Coord(80 + static_cast<int>(n % 3), 24));
+
+		return static_cast<std::size_t>(cursorPosition.x + cursorPosition.y);
+	}); });
+
+	run("terminal/getErasePosition", [&]() { return measure("terminal/getErasePosition", samples, [&]()
+	{
+		std::size_t n = index++;
+
+		Coord cursorPosition = Terminal::getErasePosition(Coord(static_cast<int>(n % 80), 10), Coord(80, 24), n % 512);
+
+		return static_cast<std::size_t>(cursorPosition.x + cursorPosition.y);
+	}); });
+
+	try
+	{
+		run("framing/16B", [&]() { return measureFraming("framing/16B", samples, port, 16); });
+
+		run("framing/256B", [&]() { return measureFraming("framing/256B", samples, port + 1, 256); });
+
+		run("framing/4KiB", [&]() { return measureFraming("framing/4KiB", samples, port + 2, 4096); });
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		std::cerr << runtimeError.what() << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
@@ -26,100 +26,208 @@ int close(SOCKET s)
 
 #endif
 
-std::vector<std::string> Network::resolveHostAddressesIPv4(const std::string& host)
+Endpoint::Endpoint() : length(0)
 {
-	std::vector<std::string> addresses;
-
-	addrinfo* info = nullptr;
+	std::memset(&(this->address), 0, sizeof(this->address));
+}
 
-	if (!getaddrinfo(unmapIPv4(host).c_str(), nullptr, nullptr, &info))
-	{
-		addrinfo* current = info;
+sockaddr* Endpoint::getAddress()
+{
+	return reinterpret_cast<sockaddr*>(&(this->address));
+}
 
-		if (current)
-		{
-			do
-			{
-				sockaddr_in addr;
+const sockaddr* Endpoint::getAddress() const
+{
+	return reinterpret_cast<const sockaddr*>(&(this->address));
+}
 
-				if (current->ai_family = AF_INET && current->ai_addr && current->ai_addrlen == sizeof(addr))
-				{
-					std::memcpy(&addr, current->ai_addr, current->ai_addrlen);
+int Endpoint::getFamily() const
+{
+	return this->address.ss_family;
+}
 
-					std::array<char, INET_ADDRSTRLEN> buffer;
+std::string Endpoint::toString() const
+{
+	std::array<char, INET6_ADDRSTRLEN> buffer;
 
-					std::memset(buffer.data(), 0, buffer.size());
+	std::memset(buffer.data(), 0, buffer.size());
 
-					if (inet_ntop(AF_INET, &(addr.sin_addr), buffer.data(), buffer.size()))
-					{
-						addresses.push_back(buffer.data());
-					}
-				}
+	if (this->getFamily() == AF_INET6)
+	{
+		const sockaddr_in6* addr = reinterpret_cast<const sockaddr_in6*>(&(this->address));
 
-				current = current->ai_next;
-			}
-			while (current);
-		}
+		inet_ntop(AF_INET6, &(addr->sin6_addr), buffer.data(), buffer.size());
+	}
+	else if (this->getFamily() == AF_INET)
+	{
+		const sockaddr_in* addr = reinterpret_cast<const sockaddr_in*>(&(this->address));
 
-		freeaddrinfo(info);
+		inet_ntop(AF_INET, &(addr->sin_addr), buffer.data(), buffer.size());
 	}
 
-	return addresses;
+	return buffer.data();
 }
 
-std::vector<std::string> Network::resolveHostAddressesIPv6(const std::string& host)
+std::vector<Endpoint> Network::resolve(const std::string& host, unsigned short port)
 {
-	std::vector<std::string> addresses;
+	std::string name = unmapIPv4(host);
+
+	std::vector<Endpoint> endpoints;
+
+	std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+	{
+		std::lock_guard<std::mutex> lockGuard(mutex);
+
+		std::map<std::string, Resolution>::iterator iter = cache.find(name);
 
-	addrinfo* info = nullptr;
+		if (iter != cache.end())
+		{
+			if (iter->second.expiry > now)
+			{
+				endpoints = iter->second.endpoints;
+			}
+			else
+			{
+				cache.erase(iter);
+			}
+		}
+	}
 
-	if (!getaddrinfo(unmapIPv4(host).c_str(), nullptr, nullptr, &info))
+	if (endpoints.size() == 0)
 	{
-		addrinfo* current = info;
+		addrinfo hints;
+
+		std::memset(&hints, 0, sizeof(hints));
 
-		if (current)
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+
+		addrinfo* info = nullptr;
+
+		if (!getaddrinfo(name.c_str(), nullptr, &hints, &info))
 		{
-			do
+			for (addrinfo* current = info; current; current = current->ai_next)
 			{
-				sockaddr_in6 addr;
+				if ((current->ai_family == AF_INET || current->ai_family == AF_INET6) && current->ai_addr && current->ai_addrlen <= sizeof(sockaddr_storage))
+				{
+					Endpoint endpoint;
+
+					std::memcpy(&(endpoint.address), current->ai_addr, current->ai_addrlen);
+
+					endpoint.length = static_cast<socklen_t>(current->ai_addrlen);
+
+					endpoints.push_back(endpoint);
+				}
+			}
+
+			freeaddrinfo(info);
+		}
+
+		if (endpoints.size() > 0)
+		{
+			std::lock_guard<std::mutex> lockGuard(mutex);
+
+			std::map<std::string, Resolution>::iterator iter;
 
-				if (current->ai_family = AF_INET6 && current->ai_addr && current->ai_addrlen == sizeof(addr))
+			for (iter = cache.begin(); iter != cache.end(); )
+			{
+				if (iter->second.expiry <= now)
 				{
-					std::memcpy(&addr, current->ai_addr, current->ai_addrlen);
+					iter = cache.erase(iter);
 
-					std::array<char, INET6_ADDRSTRLEN> buffer;
+					continue;
+				}
 
-					std::memset(buffer.data(), 0, buffer.size());
+				iter++;
+			}
 
-					if (inet_ntop(AF_INET6, &(addr.sin6_addr), buffer.data(), buffer.size()))
+			if (cache.size() >= ResolveCacheSize && cache.find(name) == cache.end())
+			{
+				std::map<std::string, Resolution>::iterator oldest = cache.begin();
+
+				for (iter = cache.begin(); iter != cache.end(); iter++)
+				{
+					if (iter->second.expiry < oldest->second.expiry)
 					{
-						addresses.push_back(buffer.data());
+						oldest = iter;
 					}
 				}
 
-				current = current->ai_next;
-			} while (current);
+				cache.erase(oldest);
+			}
+
+			Resolution& resolution = cache[name];
+
+			resolution.expiry = now + ResolveTtl;
+			resolution.endpoints = endpoints;
 		}
+	}
 
-		freeaddrinfo(info);
+	for (Endpoint& endpoint : endpoints)
+	{
+		if (endpoint.getFamily() == AF_INET6)
+		{
+			reinterpret_cast<sockaddr_in6*>(&(endpoint.address))->sin6_port = htons(port);
+		}
+		else
+		{
+			reinterpret_cast<sockaddr_in*>(&(endpoint.address))->sin_port = htons(port);
+		}
 	}
 
-	return addresses;
+	return endpoints;
 }
 
-std::vector<std::string> Network::resolveHostAddresses(const std::string& host)
+std::vector<Endpoint> Network::interleave(const std::vector<Endpoint>& endpoints)
 {
-	std::vector<std::string> addresses;
+	std::vector<Endpoint> primary;
+	std::vector<Endpoint> secondary;
 
-	std::vector<std::string> addressesIPv4 = resolveHostAddressesIPv4(host);
+	for (const Endpoint& endpoint : endpoints)
+	{
+		if (endpoint.getFamily() == endpoints.front().getFamily())
+		{
+			primary.push_back(endpoint);
+		}
+		else
+		{
+			secondary.push_back(endpoint);
+		}
+	}
 
-	std::vector<std::string> addressesIPv6 = resolveHostAddressesIPv6(host);
+	std::vector<Endpoint> interleaved;
+
+	for (std::size_t i = 0; i < std::max(primary.size(), secondary.size()); i++)
+	{
+		if (i < primary.size())
+		{
+			interleaved.push_back(primary[i]);
+		}
 
-	addresses.insert(addresses.end(), addressesIPv6.begin(), addressesIPv6.end());
+		if (i < secondary.size())
+		{
+			interleaved.push_back(secondary[i]);
+		}
+	}
 
-	addresses.insert(addresses.end(), addressesIPv4.begin(), addressesIPv4.end());
+	return interleaved;
+}
 
-	return addresses;
+std::vector<std::string> Network::resolveHostAddressesIPv4(const std::string& host)
+{
+	return resolveHostAddresses(host, AF_INET);
+}
+
+std::vector<std::string> Network::resolveHostAddressesIPv6(const std::string& host)
+{
+	return resolveHostAddresses(host, AF_INET6);
+}
+
+std::vector<std::string> Network::resolveHostAddresses(const std::string& host)
+{
+	return resolveHostAddresses(host, AF_UNSPEC);
 }
 
 std::string Network::resolveHostIPv4(const std::string& host)
@@ -160,50 +268,49 @@ std::string Network::resolveHost(const std::string& host)
 
 std::pair<std::string, unsigned short> Network::splitAddress(const std::string& address)
 {
-	std::string ipAddress = address;
 	unsigned short port = DefaultPort;
 
-	std::size_t pos = address.find('[');
-
-	if (pos == 0)
-	{
-		pos = address.find(']');
+	StringView ipAddress = splitAddress(StringView(address), port);
 
-		if (pos != std::string::npos)
-		{
-			ipAddress = std::string(address.begin() + 1, address.begin() + pos);
+	return std::pair<std::string, unsigned short>(ipAddress.str(), port);
+}
 
-			std::string portStr = std::string(address.begin() + pos + 1, address.end());
+StringView Network::splitAddress(const StringView& address, unsigned short& port)
+{
+	port = DefaultPort;
 
-			pos = portStr.rfind(':');
+	const char* begin = address.data;
+	const char* end = address.data + address.length;
 
-			if (pos == 0)
-			{
-				portStr = std::string(portStr.begin() + 1, portStr.end());
+	if (begin != end && *begin == '[')
+	{
+		const char* bracket = std::find(begin, end, ']');
 
-				std::stringstream stream(portStr);
+		if (bracket != end)
+		{
+			const char* colon = bracket + 1;
 
-				stream >> port;
+			if (colon != end && *colon == ':' && std::find(colon + 1, end, ':') == end)
+			{
+				port = parsePort(colon + 1, end, port);
 			}
+
+			return StringView(begin + 1, static_cast<std::size_t>(bracket - begin - 1));
 		}
 	}
 	else
 	{
-		pos = address.rfind(':');
+		const char* colon = std::find(begin, end, ':');
 
-		if (pos != std::string::npos && address.find(':') == address.rfind(':'))
+		if (colon != end && std::find(colon + 1, end, ':') == end)
 		{
-			ipAddress = std::string(address.begin(), address.begin() + pos);
-
-			std::string portStr = std::string(address.begin() + pos + 1, address.end());
-
-			std::stringstream stream(portStr);
+			port = parsePort(colon + 1, end, port);
 
-			stream >> port;
+			return StringView(begin, static_cast<std::size_t>(colon - begin));
 		}
 	}
 
-	return std::pair<std::string, unsigned short>(ipAddress, port);
+	return address;
 }
 
 std::string Network::mapIPv4(const std::string& address)
@@ -213,25 +320,170 @@ std::string Network::mapIPv4(const std::string& address)
 
 std::string Network::unmapIPv4(const std::string& address)
 {
-	std::size_t pos = address.find("::ffff:");
+	StringView ipv4Address = unmapIPv4(StringView(address));
 
-	if (pos == 0)
+	if (ipv4Address.length == address.length())
 	{
-		std::string ipv4Address(address.begin() + 7, address.end());
+		return address;
+	}
 
-		pos = ipv4Address.find(':');
+	return ipv4Address.str();
+}
 
-		std::size_t posDot = ipv4Address.find('.');
+StringView Network::unmapIPv4(const StringView& address)
+{
+	if (address.length >= 7 && std::memcmp(address.data, "::ffff:", 7) == 0)
+	{
+		const char* begin = address.data + 7;
+		const char* end = address.data + address.length;
 
-		if (pos == std::string::npos && posDot != std::string::npos)
+		if (std::find(begin, end, ':') == end && std::find(begin, end, '.') != end)
 		{
-			return ipv4Address;
+			return StringView(begin, static_cast<std::size_t>(end - begin));
 		}
 	}
 
 	return address;
 }
 
+bool Network::isUnixAddress(const std::string& address)
+{
+	return address.compare(0, UnixPrefix.length(), UnixPrefix) == 0;
+}
+
+Endpoint Network::getUnixEndpoint(const std::string& path)
+{
+	Endpoint endpoint;
+
+	#if defined(POSIX)
+
+	sockaddr_un* addr = reinterpret_cast<sockaddr_un*>(endpoint.getAddress());
+
+	if (path.empty() || path.length() >= sizeof(addr->sun_path))
+	{
+		throw std::runtime_error("Invalid UNIX socket path " + path);
+	}
+
+	addr->sun_family = AF_UNIX;
+
+	std::memcpy(addr->sun_path, path.data(), path.length());
+
+	endpoint.length = sizeof(sockaddr_un);
+
+	#else
+
+	throw std::runtime_error("UNIX domain sockets are not supported on this platform");
+
+	#endif
+
+	return endpoint;
+}
+
+std::vector<std::string> Network::resolveHostAddresses(const std::string& host, int family)
+{
+	std::vector<std::string> addresses;
+
+	for (const Endpoint& endpoint : resolve(host, 0))
+	{
+		if (family == AF_UNSPEC || endpoint.getFamily() == family)
+		{
+			addresses.push_back(endpoint.toString());
+		}
+	}
+
+	return addresses;
+}
+
+unsigned short Network::parsePort(const char* begin, const char* end, unsigned short port)
+{
+	while (begin != end && std::isspace(static_cast<unsigned char>(*begin)))
+	{
+		begin++;
+	}
+
+	if (begin == end)
+	{
+		return port;
+	}
+
+	bool negative = *begin == '-';
+
+	if (*begin == '-' || *begin == '+')
+	{
+		begin++;
+	}
+
+	unsigned long value = 0;
+
+	for (; begin != end && *begin >= '0' && *begin <= '9'; begin++)
+	{
+		value = std::min(value * 10 + static_cast<unsigned long>(*begin - '0'), 65536ul);
+	}
+
+	if (value > 65535)
+	{
+		return 65535;
+	}
+
+	return static_cast<unsigned short>(negative ? 65536 - value : value);
+}
+
+int Network::getLastError()
+{
+	#if defined(WINDOWS)
+
+	return WSAGetLastError();
+
+	#elif defined(POSIX)
+
+	return errno;
+
+	#endif
+}
+
+bool Network::isWouldBlock(int error)
+{
+	#if defined(WINDOWS)
+
+	return error == WSAEWOULDBLOCK;
+
+	#elif defined(POSIX)
+
+	return error == EAGAIN || error == EWOULDBLOCK;
+
+	#endif
+}
+
+bool Network::isInProgress(int error)
+{
+	#if defined(WINDOWS)
+
+	return error == WSAEWOULDBLOCK;
+
+	#elif defined(POSIX)
+
+	return error == EINPROGRESS;
+
+	#endif
+}
+
+void Network::setNonBlocking(Socket socket, bool nonBlocking)
+{
+	#if defined(WINDOWS)
+
+	u_long mode = nonBlocking ? 1 : 0;
+
+	ioctlsocket(socket, FIONBIO, &mode);
+
+	#elif defined(POSIX)
+
+	int flags = fcntl(socket, F_GETFL, 0);
+
+	fcntl(socket, F_SETFL, nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+
+	#endif
+}
+
 void Network::startup()
 {
 	std::lock_guard<std::mutex> lockGuard(mutex);
@@ -280,8 +532,16 @@ void Network::cleanup()
 
 const unsigned short Network::DefaultPort = 1024;
 
+const std::string Network::UnixPrefix = "unix:";
+
 const int Network::MaxConnections = SOMAXCONN;
 
+const std::chrono::seconds Network::ResolveTtl(60);
+
+const std::size_t Network::ResolveCacheSize = 256;
+
+std::map<std::string, Network::Resolution> Network::cache;
+
 int Network::counter = 0;
 
 std::mutex Network::mutex;
@@ -26,6 +26,11 @@
 #include <vector>
 #include <cstring>
 #include <sstream>
+#include <cerrno>
+#include <map>
+#include <chrono>
+#include <cctype>
+#include <algorithm>
 
 #if defined(WINDOWS)
 
@@ -39,6 +44,8 @@ extern int close(SOCKET s);
 
 #define SHUT_WR SD_SEND
 
+#define MSG_NOSIGNAL 0
+
 #elif defined(POSIX)
 
 #include <unistd.h>
@@ -46,8 +53,13 @@ extern int close(SOCKET s);
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
 
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 
@@ -56,11 +68,38 @@ typedef int Socket;
 #define INVALID_SOCKET -1
 #define SOCKET_ERROR -1
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 #endif
 
+#include "string-view.hpp"
+
+struct Endpoint
+{
+public:
+	Endpoint();
+
+	sockaddr* getAddress();
+
+	const sockaddr* getAddress() const;
+
+	int getFamily() const;
+
+	std::string toString() const;
+
+	sockaddr_storage address;
+	socklen_t length;
+};
+
 class Network
 {
 public:
+	static std::vector<Endpoint> resolve(const std::string& host, unsigned short port);
+
+	static std::vector<Endpoint> interleave(const std::vector<Endpoint>& endpoints);
+
 	static std::vector<std::string> resolveHostAddressesIPv4(const std::string& host);
 
 	static std::vector<std::string> resolveHostAddressesIPv6(const std::string& host);
@@ -75,19 +114,54 @@ public:
 
 	static std::pair<std::string, unsigned short> splitAddress(const std::string& address);
 
+	static StringView splitAddress(const StringView& address, unsigned short& port);
+
 	static std::string mapIPv4(const std::string& address);
 
 	static std::string unmapIPv4(const std::string& address);
 
+	static bool isUnixAddress(const std::string& address);
+
+	static Endpoint getUnixEndpoint(const std::string& path);
+
+	static StringView unmapIPv4(const StringView& address);
+
+	static int getLastError();
+
+	static bool isWouldBlock(int error);
+
+	static bool isInProgress(int error);
+
+	static void setNonBlocking(Socket socket, bool nonBlocking = true);
+
 	static void startup();
 
 	static void cleanup();
 
 	static const unsigned short DefaultPort;
 
+	static const std::string UnixPrefix;
+
 	static const int MaxConnections;
 
+	static const std::chrono::seconds ResolveTtl;
+
+	static const std::size_t ResolveCacheSize;
+
 private:
+	struct Resolution
+	{
+		std::chrono::time_point<std::chrono::steady_clock> expiry;
+
+		std::vector<Endpoint> endpoints;
+	};
+
+	static std::vector<std::string> resolveHostAddresses(const std::string& host, int family);
+
+	static unsigned short parsePort(const char* begin, const char* end, unsigned short port);
+
+	static std::map<std::string, Resolution> cache;
+
 	static int counter;
 
 	static std::mutex mutex;
@@ -0,0 +1,162 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <utility>
+#include <cstddef>
+
+template <typename T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(std::size_t capacity);
+
+	std::size_t size() const;
+
+	std::size_t getCapacity() const;
+
+	bool push(T& item);
+
+	bool tryPush(T& item);
+
+	bool pop(T& item, std::chrono::milliseconds timeout);
+
+	void close();
+
+private:
+	std::vector<T> slots;
+
+	std::size_t head;
+
+	std::atomic<std::size_t> count;
+
+	bool closed;
+
+	mutable std::mutex mutex;
+
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+};
+
+template <typename T>
+BoundedQueue<T>::BoundedQueue(std::size_t capacity) : slots(capacity), head(0), count(0), closed(false)
+{
+
+}
+
+template <typename T>
+std::size_t BoundedQueue<T>::size() const
+{
+	return this->count;
+}
+
+template <typename T>
+std::size_t BoundedQueue<T>::getCapacity() const
+{
+	return this->slots.size();
+}
+
+template <typename T>
+bool BoundedQueue<T>::push(T& item)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	this->notFull.wait(lock, [this]() { return this->closed || this->count < this->slots.size(); });
+
+	if (this->closed)
+	{
+		return false;
+	}
+
+	std::swap(this->slots[(this->head + this->count) % this->slots.size()], item);
+
+	this->count++;
+
+	lock.unlock();
+
+	this->notEmpty.notify_one();
+
+	return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::tryPush(T& item)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	if (this->closed || this->count == this->slots.size())
+	{
+		return false;
+	}
+
+	std::swap(this->slots[(this->head + this->count) % this->slots.size()], item);
+
+	this->count++;
+
+	lock.unlock();
+
+	this->notEmpty.notify_one();
+
+	return true;
+}
+
+template <typename T>
+bool BoundedQueue<T>::pop(T& item, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	if (!this->notEmpty.wait_for(lock, timeout, [this]() { return this->closed || this->count > 0; }) || this->count == 0)
+	{
+		return false;
+	}
+
+	std::size_t slot = this->head;
+
+	std::swap(this->slots[slot], item);
+
+	this->head = (this->head + 1) % this->slots.size();
+
+	this->count--;
+
+	std::swap(this->slots[slot], this->slots[(this->head + this->count) % this->slots.size()]);
+
+	lock.unlock();
+
+	this->notFull.notify_one();
+
+	return true;
+}
+
+template <typename T>
+void BoundedQueue<T>::close()
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+		this->closed = true;
+	}
+
+	this->notEmpty.notify_all();
+
+	this->notFull.notify_all();
+}
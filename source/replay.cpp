@@ -0,0 +1,302 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+
+#include "arguments.hpp"
+#include "tcp-socket.hpp"
+#include "capture.hpp"
+
+std::string msgHelp =
+"replay:\n"
+"Replay: -f [capture] -j [ip[:port=1024]] [-speed [factor=1|max]]\n"
+"Captures are recorded by terminal-chat with -h [port] -capture [file]";
+
+struct Replayed
+{
+	std::unique_ptr<TcpSocket> tcpSocket;
+
+	std::string name;
+	std::string partial;
+};
+
+typedef std::unordered_map<std::string, std::deque<std::chrono::steady_clock::time_point>> Pending;
+
+void observe(TcpSocket& observer, Pending& pending, std::vector<double>& latencies)
+{
+	observer.process();
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	StringView line;
+
+	while (observer.readLine(line))
+	{
+		if (line.length == 0 || line.data[0] == '\b')
+		{
+			continue;
+		}
+
+		Pending::iterator iter = pending.find(line.str());
+
+		if (iter != pending.end())
+		{
+			latencies.push_back(std::chrono::duration<double, std::micro>(now - iter->second.front()).count());
+
+			iter->second.pop_front();
+
+			if (iter->second.empty())
+			{
+				pending.erase(iter);
+			}
+		}
+	}
+}
+
+void drain(std::unordered_map<unsigned int, Replayed>& connections)
+{
+	for (auto& connection : connections)
+	{
+		TcpSocket& tcpSocket = *connection.second.tcpSocket;
+
+		tcpSocket.process();
+
+		while (tcpSocket.hasLine())
+		{
+			tcpSocket.readLine();
+		}
+	}
+}
+
+void send(Replayed& replayed, const Capture::Record& record, Pending& pending)
+{
+	if (record.type == Capture::Part)
+	{
+		replayed.partial += record.line;
+
+		return;
+	}
+
+	if (!replayed.partial.empty())
+	{
+		replayed.tcpSocket->writeLine({ replayed.partial, record.line });
+
+		replayed.partial.clear();
+
+		return;
+	}
+
+	replayed.tcpSocket->writeLine(record.line);
+
+	if (record.line.empty() || record.line[0] == '\b')
+	{
+		return;
+	}
+
+	if (replayed.name.empty())
+	{
+		replayed.name = record.line;
+	}
+	else
+	{
+		pending[replayed.name + ": " + record.line].push_back(std::chrono::steady_clock::now());
+	}
+}
+
+double getPercentile(const std::vector<double>& sorted, double percentile)
+{
+	if (sorted.empty())
+	{
+		return 0.0;
+	}
+
+	return sorted[std::min(sorted.size() - 1, static_cast<std::size_t>(static_cast<double>(sorted.size()) * percentile))];
+}
+
+void replay(const std::vector<Capture::Record>& records, const std::string& address, double speed)
+{
+	TcpSocket observer;
+
+	observer.connect(address);
+	observer.writeLine("replay");
+
+	while (observer.isConnected() && !observer.hasLine())
+	{
+		observer.wait(std::chrono::milliseconds(10));
+
+		observer.process();
+	}
+
+	std::unordered_map<unsigned int, Replayed> connections;
+
+	Pending pending;
+
+	std::vector<double> latencies;
+
+	std::size_t opened = 0;
+	std::size_t sent = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point drained = start;
+
+	for (const Capture::Record& record : records)
+	{
+		if (speed > 0.0)
+		{
+			std::chrono::steady_clock::time_point due = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::micro>(static_cast<double>(record.time) / speed));
+
+			for (std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now(); now < due; now = std::chrono::steady_clock::now())
+			{
+				observer.wait(std::min(std::chrono::milliseconds(1), std::chrono::duration_cast<std::chrono::milliseconds>(due - now)));
+
+				observe(observer, pending, latencies);
+			}
+		}
+
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		if (now - drained >= std::chrono::milliseconds(10))
+		{
+			drain(connections);
+
+			drained = now;
+		}
+
+		switch (record.type)
+		{
+		case Capture::Open:
+		{
+			Replayed& replayed = connections[record.connection];
+
+			replayed.tcpSocket.reset(new TcpSocket());
+
+			try
+			{
+				replayed.tcpSocket->connect(address);
+
+				opened++;
+			}
+			catch (const std::runtime_error& runtimeError)
+			{
+				std::cerr << runtimeError.what() << std::endl;
+			}
+
+			break;
+		}
+		case Capture::Line:
+		case Capture::Part:
+		{
+			std::unordered_map<unsigned int, Replayed>::iterator iter = connections.find(record.connection);
+
+			if (iter != connections.end())
+			{
+				send(iter->second, record, pending);
+
+				sent++;
+			}
+
+			break;
+		}
+		case Capture::Close:
+		{
+			connections.erase(record.connection);
+
+			break;
+		}
+		}
+
+		observe(observer, pending, latencies);
+	}
+
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	while (!pending.empty() && observer.isConnected() && std::chrono::steady_clock::now() - end < std::chrono::seconds(2))
+	{
+		observer.wait(std::chrono::milliseconds(10));
+
+		observe(observer, pending, latencies);
+
+		drain(connections);
+	}
+
+	std::size_t lost = 0;
+
+	for (auto& entry : pending)
+	{
+		lost += entry.second.size();
+	}
+
+	std::sort(latencies.begin(), latencies.end());
+
+	float captured = records.empty() ? 0.0f : static_cast<float>(records.back().time) / 1000000.0f;
+
+	std::cout << "replay: " << records.size() << " records, " << opened << " connections, " << sent << " frames in "
+		<< std::chrono::duration<float>(end - start).count() << " s (captured " << captured << " s, speed ";
+
+	if (speed > 0.0)
+	{
+		std::cout << speed << "x)" << std::endl;
+	}
+	else
+	{
+		std::cout << "max)" << std::endl;
+	}
+
+	std::cout << "delivery latency: " << latencies.size() << " messages, p50 " << getPercentile(latencies, 0.5) << " us, p90 "
+		<< getPercentile(latencies, 0.9) << " us, p99 " << getPercentile(latencies, 0.99) << " us, max "
+		<< (latencies.empty() ? 0.0 : latencies.back()) << " us, " << lost << " not delivered" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	Arguments::setArgs(argc, argv);
+
+	if (!Arguments::hasArgument("f") || !Arguments::hasArgument("j"))
+	{
+		std::cerr << msgHelp << std::endl;
+
+		return 1;
+	}
+
+	double speed = 1.0;
+
+	if (Arguments::hasArgument("speed"))
+	{
+		std::string argument = Arguments::getArgument("speed");
+
+		speed = argument == "max" ? 0.0 : std::atof(argument.c_str());
+	}
+
+	try
+	{
+		replay(Capture::load(Arguments::getArgument("f")), Arguments::getArgument("j"), speed);
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		std::cerr << runtimeError.what() << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
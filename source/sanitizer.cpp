@@ -0,0 +1,140 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sanitizer.hpp"
+#include "scanner.hpp"
+
+const char* Sanitizer::Replacement = "\xEF\xBF\xBD";
+
+bool Sanitizer::sanitize(const char* data, std::size_t length, std::string& output)
+{
+	bool altered = false;
+
+	std::size_t i = 0;
+
+	while (i < length)
+	{
+		std::size_t clean = Scanner::skipPrintable(data, i, length);
+
+		output.append(data + i, clean - i);
+
+		i = clean;
+
+		if (i >= length)
+		{
+			break;
+		}
+
+		unsigned char byte = static_cast<unsigned char>(data[i]);
+
+		if (byte < 0x80)
+		{
+			if (byte == '\v')
+			{
+				output.push_back('\v');
+			}
+			else
+			{
+				output.push_back('^');
+				output.push_back(byte == 0x7F ? '?' : static_cast<char>(byte + '@'));
+
+				altered = true;
+			}
+
+			i++;
+
+			continue;
+		}
+
+		unsigned codePoint = 0;
+
+		std::size_t size = decode(reinterpret_cast<const unsigned char*>(data + i), length - i, codePoint);
+
+		if (size == 0 || codePoint < 0xA0)
+		{
+			output.append(Replacement);
+
+			altered = true;
+
+			i += size > 0 ? size : 1;
+
+			continue;
+		}
+
+		output.append(data + i, size);
+
+		i += size;
+	}
+
+	return altered;
+}
+
+std::size_t Sanitizer::decode(const unsigned char* data, std::size_t length, unsigned& codePoint)
+{
+	unsigned char lead = data[0];
+
+	std::size_t size = 0;
+
+	unsigned char low = 0x80;
+	unsigned char high = 0xBF;
+
+	if (lead >= 0xC2 && lead <= 0xDF)
+	{
+		size = 2;
+
+		codePoint = lead & 0x1F;
+	}
+	else if (lead >= 0xE0 && lead <= 0xEF)
+	{
+		size = 3;
+
+		codePoint = lead & 0x0F;
+
+		low = lead == 0xE0 ? 0xA0 : 0x80;
+		high = lead == 0xED ? 0x9F : 0xBF;
+	}
+	else if (lead >= 0xF0 && lead <= 0xF4)
+	{
+		size = 4;
+
+		codePoint = lead & 0x07;
+
+		low = lead == 0xF0 ? 0x90 : 0x80;
+		high = lead == 0xF4 ? 0x8F : 0xBF;
+	}
+	else
+	{
+		return 0;
+	}
+
+	if (length < size || data[1] < low || data[1] > high)
+	{
+		return 0;
+	}
+
+	for (std::size_t i = 1; i < size; i++)
+	{
+		if ((data[i] & 0xC0) != 0x80)
+		{
+			return 0;
+		}
+
+		codePoint = (codePoint << 6) | (data[i] & 0x3F);
+	}
+
+	return size;
+}
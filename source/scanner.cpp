@@ -0,0 +1,384 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "scanner.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#define SCANNER_SSE2
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+#define SCANNER_AVX2
+
+#elif defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__))
+
+#define SCANNER_AVX2
+
+#define SCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+
+#endif
+
+#endif
+
+#ifndef SCANNER_TARGET_AVX2
+
+#define SCANNER_TARGET_AVX2
+
+#endif
+
+namespace
+{
+	inline unsigned countTrailingZeros(unsigned mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index = 0;
+
+		_BitScanForward(&index, mask);
+
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+
+	inline std::size_t skipLines(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions)
+	{
+		std::size_t i = begin;
+
+		while (i < end)
+		{
+			const char* position = static_cast<const char*>(std::memchr(data + i, '\n', end - i));
+
+			if (position == nullptr)
+			{
+				break;
+			}
+
+			std::size_t found = static_cast<std::size_t>(position - data);
+
+			positions.push_back(found);
+
+			if (found - i < 64)
+			{
+				return found + 1;
+			}
+
+			i = found + 1;
+		}
+
+		return end;
+	}
+
+	inline void collect(unsigned mask, std::size_t offset, std::vector<std::size_t>& positions)
+	{
+		while (mask != 0)
+		{
+			positions.push_back(offset + countTrailingZeros(mask));
+
+			mask &= mask - 1;
+		}
+	}
+}
+
+void Scanner::scan(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions)
+{
+	scan(getKernel(), data, begin, end, positions);
+}
+
+void Scanner::scan(Kernel kernel, const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions)
+{
+	switch (kernel)
+	{
+	case Avx2:
+	{
+		scanAvx2(data, begin, end, positions);
+
+		break;
+	}
+	case Sse2:
+	{
+		scanSse2(data, begin, end, positions);
+
+		break;
+	}
+	default:
+	{
+		scanScalar(data, begin, end, positions);
+
+		break;
+	}
+	}
+}
+
+std::size_t Scanner::skipPrintable(const char* data, std::size_t begin, std::size_t end)
+{
+	return skipPrintable(getKernel(), data, begin, end);
+}
+
+std::size_t Scanner::skipPrintable(Kernel kernel, const char* data, std::size_t begin, std::size_t end)
+{
+	switch (kernel)
+	{
+	case Avx2:
+	{
+		return skipPrintableAvx2(data, begin, end);
+	}
+	case Sse2:
+	{
+		return skipPrintableSse2(data, begin, end);
+	}
+	default:
+	{
+		return skipPrintableScalar(data, begin, end);
+	}
+	}
+}
+
+bool Scanner::isSupported(Kernel kernel)
+{
+	return kernel <= getKernel();
+}
+
+Scanner::Kernel Scanner::getKernel()
+{
+	static const Kernel kernel = detectKernel();
+
+	return kernel;
+}
+
+const char* Scanner::getName(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Avx2:
+	{
+		return "avx2";
+	}
+	case Sse2:
+	{
+		return "sse2";
+	}
+	default:
+	{
+		return "scalar";
+	}
+	}
+}
+
+Scanner::Kernel Scanner::detectKernel()
+{
+#if defined(SCANNER_AVX2) && defined(_MSC_VER)
+	int info[4];
+
+	__cpuid(info, 0);
+
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		__cpuidex(info, 7, 0);
+
+		if (osxsave && avx && (info[1] & (1 << 5)) != 0 && (_xgetbv(0) & 6) == 6)
+		{
+			return Avx2;
+		}
+	}
+#elif defined(SCANNER_AVX2)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return Avx2;
+	}
+#endif
+
+#if defined(SCANNER_SSE2)
+	return Sse2;
+#else
+	return Scalar;
+#endif
+}
+
+void Scanner::scanScalar(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions)
+{
+	const char* position = data + begin;
+	const char* last = data + end;
+
+	while (position < last && (position = static_cast<const char*>(std::memchr(position, '\n', static_cast<std::size_t>(last - position)))) != nullptr)
+	{
+		positions.push_back(static_cast<std::size_t>(position - data));
+
+		position++;
+	}
+}
+
+void Scanner::scanSse2(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions)
+{
+#if defined(SCANNER_SSE2)
+	const __m128i newline = _mm_set1_epi8('\n');
+
+	std::size_t i = begin;
+
+	while (i + 64 <= end)
+	{
+		__m128i a = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), newline);
+		__m128i b = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 16)), newline);
+		__m128i c = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 32)), newline);
+		__m128i d = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 48)), newline);
+
+		if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))) == 0)
+		{
+			i = skipLines(data, i + 64, end, positions);
+
+			continue;
+		}
+
+		collect(static_cast<unsigned>(_mm_movemask_epi8(a)), i, positions);
+		collect(static_cast<unsigned>(_mm_movemask_epi8(b)), i + 16, positions);
+		collect(static_cast<unsigned>(_mm_movemask_epi8(c)), i + 32, positions);
+		collect(static_cast<unsigned>(_mm_movemask_epi8(d)), i + 48, positions);
+
+		i += 64;
+	}
+
+	for (; i + 16 <= end; i += 16)
+	{
+		collect(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), newline))), i, positions);
+	}
+
+	scanScalar(data, i, end, positions);
+#else
+	scanScalar(data, begin, end, positions);
+#endif
+}
+
+SCANNER_TARGET_AVX2 void Scanner::scanAvx2(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions)
+{
+#if defined(SCANNER_AVX2)
+	const __m256i newline = _mm256_set1_epi8('\n');
+
+	std::size_t i = begin;
+
+	while (i + 64 <= end)
+	{
+		__m256i a = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), newline);
+		__m256i b = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 32)), newline);
+
+		unsigned low = static_cast<unsigned>(_mm256_movemask_epi8(a));
+		unsigned high = static_cast<unsigned>(_mm256_movemask_epi8(b));
+
+		if ((low | high) == 0)
+		{
+			i = skipLines(data, i + 64, end, positions);
+
+			continue;
+		}
+
+		collect(low, i, positions);
+		collect(high, i + 32, positions);
+
+		i += 64;
+	}
+
+	for (; i + 32 <= end; i += 32)
+	{
+		collect(static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)), newline))), i, positions);
+	}
+
+	_mm256_zeroupper();
+
+	scanSse2(data, i, end, positions);
+#else
+	scanSse2(data, begin, end, positions);
+#endif
+}
+
+std::size_t Scanner::skipPrintableScalar(const char* data, std::size_t begin, std::size_t end)
+{
+	std::size_t i = begin;
+
+	while (i < end && data[i] >= ' ' && data[i] < 0x7F)
+	{
+		i++;
+	}
+
+	return i;
+}
+
+std::size_t Scanner::skipPrintableSse2(const char* data, std::size_t begin, std::size_t end)
+{
+#if defined(SCANNER_SSE2)
+	const __m128i low = _mm_set1_epi8(' ' - 1);
+	const __m128i high = _mm_set1_epi8(0x7F);
+
+	std::size_t i = begin;
+
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+		unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(block, low), _mm_cmplt_epi8(block, high))));
+
+		if (mask != 0xFFFF)
+		{
+			return i + countTrailingZeros(~mask);
+		}
+	}
+
+	return skipPrintableScalar(data, i, end);
+#else
+	return skipPrintableScalar(data, begin, end);
+#endif
+}
+
+SCANNER_TARGET_AVX2 std::size_t Scanner::skipPrintableAvx2(const char* data, std::size_t begin, std::size_t end)
+{
+#if defined(SCANNER_AVX2)
+	const __m256i low = _mm256_set1_epi8(' ' - 1);
+	const __m256i high = _mm256_set1_epi8(0x7F);
+
+	std::size_t i = begin;
+
+	for (; i + 32 <= end; i += 32)
+	{
+		__m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpgt_epi8(block, low), _mm256_cmpgt_epi8(high, block))));
+
+		if (mask != 0xFFFFFFFFu)
+		{
+			return i + countTrailingZeros(~mask);
+		}
+	}
+
+	_mm256_zeroupper();
+
+	return skipPrintableSse2(data, i, end);
+#else
+	return skipPrintableSse2(data, begin, end);
+#endif
+}
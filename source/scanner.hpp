@@ -0,0 +1,61 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+class Scanner
+{
+public:
+	enum Kernel
+	{
+		Scalar,
+		Sse2,
+		Avx2
+	};
+
+	static void scan(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions);
+
+	static void scan(Kernel kernel, const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions);
+
+	static std::size_t skipPrintable(const char* data, std::size_t begin, std::size_t end);
+
+	static std::size_t skipPrintable(Kernel kernel, const char* data, std::size_t begin, std::size_t end);
+
+	static bool isSupported(Kernel kernel);
+
+	static Kernel getKernel();
+
+	static const char* getName(Kernel kernel);
+
+private:
+	static Kernel detectKernel();
+
+	static void scanScalar(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions);
+
+	static void scanSse2(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions);
+
+	static void scanAvx2(const char* data, std::size_t begin, std::size_t end, std::vector<std::size_t>& positions);
+
+	static std::size_t skipPrintableScalar(const char* data, std::size_t begin, std::size_t end);
+
+	static std::size_t skipPrintableSse2(const char* data, std::size_t begin, std::size_t end);
+
+	static std::size_t skipPrintableAvx2(const char* data, std::size_t begin, std::size_t end);
+};
@@ -17,189 +17,2731 @@
 
 #include "server.hpp"
 
-User::User(std::shared_ptr<TcpSocket> tcpSocket) : tcpSocket(tcpSocket)
+Message::Message()
+{
+
+}
+
+Message::Message(const StringView& prefix, const StringView& body) : prefix(prefix), body(body)
+{
+
+}
+
+Message::Message(const std::shared_ptr<const Identity>& sender, const StringView& body) : sender(sender), prefix(sender->prefix), body(body)
+{
+
+}
+
+Identities::Identities() : next(0), threshold(SweepThreshold)
+{
+
+}
+
+std::shared_ptr<const Identity> Identities::intern(const std::string& name)
+{
+	std::unordered_map<std::string, Entry>::iterator iter = this->entries.find(name);
+
+	if (iter != this->entries.end())
+	{
+		std::shared_ptr<const Identity> identity = iter->second.identity.lock();
+
+		if (identity)
+		{
+			return identity;
+		}
+	}
+	else
+	{
+		if (this->entries.size() >= this->threshold)
+		{
+			this->sweep();
+		}
+
+		unsigned int id = this->next;
+
+		if (!this->released.empty())
+		{
+			id = this->released.back();
+
+			this->released.pop_back();
+		}
+		else
+		{
+			this->next++;
+		}
+
+		iter = this->entries.insert(std::make_pair(name, Entry())).first;
+
+		iter->second.id = id;
+	}
+
+	std::shared_ptr<Identity> identity = std::make_shared<Identity>();
+
+	identity->id = iter->second.id;
+	identity->name = name;
+	identity->prefix = name + ": ";
+
+	iter->second.identity = identity;
+
+	return identity;
+}
+
+void Identities::sweep()
+{
+	std::unordered_map<std::string, Entry>::iterator iter;
+
+	for (iter = this->entries.begin(); iter != this->entries.end(); )
+	{
+		if (iter->second.identity.expired())
+		{
+			this->released.push_back(iter->second.id);
+
+			iter = this->entries.erase(iter);
+
+			continue;
+		}
+
+		iter++;
+	}
+
+	this->threshold = std::max(SweepThreshold, this->entries.size() * 2);
+}
+
+FloodLimits::FloodLimits() : messages(0.0), bytes(0.0), roomMessages(0.0), roomBytes(0.0), action(Delay)
+{
+
+}
+
+User::Extras::Extras() : resumeSequence(0), transferCmd(0), transferOffset(0)
+{
+
+}
+
+User::User() : shard(0), attached(false), joined(false), resuming(false), replaced(false), quit(false), timedOut(false), peering(false), flooding(false), floodAction(FloodLimits::Delay), messageIndex(0)
 {
 	
 }
 
-bool User::isConnected() const
+TcpSocket& User::getSocket()
+{
+	return this->tcpSocket;
+}
+
+bool User::isConnected() const
+{
+	return this->tcpSocket.isConnected();
+}
+
+bool User::hasName() const
+{
+	return this->name != "";
+}
+
+std::string User::getName()
+{
+	return this->name;
+}
+
+const std::string& User::getPrefix() const
+{
+	return this->identity->prefix;
+}
+
+const std::shared_ptr<const Identity>& User::getIdentity() const
+{
+	return this->identity;
+}
+
+const std::string& User::getToken() const
+{
+	return this->token;
+}
+
+void User::setToken(const std::string& token)
+{
+	this->token = token;
+}
+
+std::size_t User::getShard() const
+{
+	return this->shard;
+}
+
+void User::setShard(std::size_t shard)
+{
+	this->shard = shard;
+}
+
+bool User::isAttached() const
+{
+	return this->attached;
+}
+
+void User::setAttached(bool attached)
+{
+	this->attached = attached;
+}
+
+bool User::hasJoined() const
+{
+	return this->joined;
+}
+
+bool User::isResuming() const
+{
+	return this->resuming;
+}
+
+const std::string& User::getResumeToken() const
+{
+	return this->extras ? this->extras->resumeToken : Empty;
+}
+
+unsigned long long User::getResumeSequence() const
+{
+	return this->extras ? this->extras->resumeSequence : 0;
+}
+
+void User::resume(const std::shared_ptr<const Identity>& identity, const std::string& token)
+{
+	this->name = identity->name;
+
+	this->identity = identity;
+
+	this->token = token;
+
+	this->resuming = false;
+}
+
+void User::reject()
+{
+	this->resuming = false;
+}
+
+void User::replace()
+{
+	this->replaced = true;
+
+	this->close();
+}
+
+bool User::isReplaced() const
+{
+	return this->replaced;
+}
+
+bool User::hasQuit() const
+{
+	return this->quit;
+}
+
+bool User::hasTimedOut() const
+{
+	return this->timedOut;
+}
+
+bool User::isPeering() const
+{
+	return this->peering;
+}
+
+const std::string& User::getPeerOrigin() const
+{
+	return this->extras ? this->extras->peerOrigin : Empty;
+}
+
+const std::string& User::getPeerSecret() const
+{
+	return this->extras ? this->extras->peerSecret : Empty;
+}
+
+bool User::hasMessage() const
+{
+	return this->messageIndex < this->messages.size();
+}
+
+Message User::getMessage()
+{
+	Message message;
+
+	if (this->messageIndex < this->messages.size())
+	{
+		message = this->messages[this->messageIndex];
+
+		this->messageIndex++;
+	}
+
+	return message;
+}
+
+void User::sendLine(const StringView& line)
+{
+	this->tcpSocket.writeLine(line);
+}
+
+void User::sendLine(std::initializer_list<StringView> parts)
+{
+	this->tcpSocket.writeLine(parts);
+}
+
+void User::sendCmd(char cmd, const StringView& argument)
+{
+	this->tcpSocket.writeCmd(cmd, argument);
+}
+
+void User::close()
+{
+	this->tcpSocket.close();
+}
+
+void User::reset()
+{
+	this->tcpSocket.close();
+
+	this->name.clear();
+
+	this->identity.reset();
+
+	this->token.clear();
+
+	this->shard = 0;
+
+	this->attached = false;
+	this->joined = false;
+	this->resuming = false;
+	this->replaced = false;
+	this->quit = false;
+	this->timedOut = false;
+	this->peering = false;
+	this->flooding = false;
+
+	this->messageBucket.configure(0.0, 0.0);
+	this->byteBucket.configure(0.0, 0.0);
+
+	this->floodAction = FloodLimits::Delay;
+
+	if (this->extras && this->extras->transferCmd == 'u' && this->extras->transfer && !this->extras->transfer->isComplete())
+	{
+		this->extras->transfer->fail();
+	}
+
+	this->extras.reset();
+
+	this->messages.clear();
+	this->messageIndex = 0;
+}
+
+void User::process()
+{
+	this->tcpSocket.process();
+
+	if (this->tcpSocket.hasTimedOut())
+	{
+		this->timedOut = true;
+
+		this->tcpSocket.close();
+	}
+}
+
+bool User::hasLine()
+{
+	return this->tcpSocket.hasLine();
+}
+
+bool User::readLine(StringView& line, TcpSocket::Fragment& fragment)
+{
+	return this->tcpSocket.readLine(line, fragment);
+}
+
+void User::unreadLine()
+{
+	this->tcpSocket.unreadLine();
+}
+
+void User::limit(const FloodLimits& limits)
+{
+	this->messageBucket.configure(limits.messages, std::max(limits.messages * FloodLimits::Burst, 1.0));
+	this->byteBucket.configure(limits.bytes, limits.bytes * FloodLimits::Burst);
+
+	this->floodAction = limits.action;
+}
+
+TokenBucket& User::getMessageBucket()
+{
+	return this->messageBucket;
+}
+
+TokenBucket& User::getByteBucket()
+{
+	return this->byteBucket;
+}
+
+FloodLimits::Action User::getFloodAction() const
+{
+	return this->floodAction;
+}
+
+bool User::isFlooding() const
+{
+	return this->flooding;
+}
+
+void User::setFlooding(bool flooding)
+{
+	this->flooding = flooding;
+}
+
+bool User::isStreaming() const
+{
+	return this->extras && this->extras->stream != "";
+}
+
+const std::string& User::getStream() const
+{
+	return this->extras ? this->extras->stream : Empty;
+}
+
+void User::setStream(const std::string& stream)
+{
+	this->getExtras().stream = stream;
+}
+
+bool User::isTransferring() const
+{
+	return this->extras && this->extras->transferCmd != 0;
+}
+
+char User::getTransferCmd() const
+{
+	return this->extras ? this->extras->transferCmd : 0;
+}
+
+const std::string& User::getTransferArgument() const
+{
+	return this->extras ? this->extras->transferArgument : Empty;
+}
+
+void User::setTransfer(const std::shared_ptr<Transfer>& transfer)
+{
+	this->getExtras().transfer = transfer;
+
+	this->extras->transferOffset = 0;
+}
+
+bool User::processTransfer()
+{
+	Extras& extras = *this->extras;
+
+	bool progress = false;
+
+	if (extras.transferCmd == 'u')
+	{
+		progress = extras.transfer->receive(this->tcpSocket);
+
+		if (extras.transfer->isComplete())
+		{
+			this->tcpSocket.close();
+		}
+	}
+	else
+	{
+		progress = extras.transfer->send(this->tcpSocket, extras.transferOffset);
+
+		if (extras.transferOffset == extras.transfer->getSize() || (extras.transfer->hasFailed() && extras.transferOffset == extras.transfer->getReceived()))
+		{
+			this->tcpSocket.close();
+		}
+	}
+
+	return progress;
+}
+
+void User::processLine(Identities& identities, const StringView& line)
+{
+	this->messages.clear();
+
+	this->messageIndex = 0;
+
+	this->joined = false;
+
+	if (line.length > 0)
+	{
+		if (line.data[0] == '\b')
+		{
+			this->processCmd(line);
+		}
+		else if (!this->hasName())
+		{
+			this->name = line.str();
+
+			this->identity = identities.intern(this->name);
+
+			this->joined = true;
+
+			this->messages.push_back(Message(this->name, " joined the chat room"));
+		}
+		else
+		{
+			this->messages.push_back(Message(this->identity, line));
+		}
+	}
+}
+
+void User::save(Handoff& handoff)
+{
+	this->tcpSocket.save(handoff);
+
+	handoff.writeString(this->name);
+	handoff.writeString(this->token);
+	handoff.writeString(this->getStream());
+
+	handoff.writeNumber(this->attached ? 1 : 0);
+	handoff.writeNumber(this->flooding ? 1 : 0);
+
+	handoff.writeReal(this->messageBucket.getRate());
+	handoff.writeReal(this->messageBucket.getCapacity());
+
+	handoff.writeReal(this->byteBucket.getRate());
+	handoff.writeReal(this->byteBucket.getCapacity());
+
+	handoff.writeNumber(this->floodAction);
+}
+
+void User::restore(Handoff& handoff, Identities& identities)
+{
+	this->reset();
+
+	this->tcpSocket.restore(handoff);
+
+	this->name = handoff.readString();
+
+	if (this->hasName())
+	{
+		this->identity = identities.intern(this->name);
+	}
+
+	this->token = handoff.readString();
+
+	std::string stream = handoff.readString();
+
+	if (!stream.empty())
+	{
+		this->setStream(stream);
+	}
+
+	this->attached = handoff.readNumber() != 0;
+	this->flooding = handoff.readNumber() != 0;
+
+	double rate = handoff.readReal();
+
+	this->messageBucket.configure(rate, handoff.readReal());
+
+	rate = handoff.readReal();
+
+	this->byteBucket.configure(rate, handoff.readReal());
+
+	unsigned long long action = handoff.readNumber();
+
+	if (action > FloodLimits::Disconnect)
+	{
+		throw std::runtime_error("Malformed handoff state");
+	}
+
+	this->floodAction = static_cast<FloodLimits::Action>(action);
+}
+
+User::Extras& User::getExtras()
+{
+	if (!this->extras)
+	{
+		this->extras.reset(new Extras());
+	}
+
+	return *this->extras;
+}
+
+void User::processCmd(const StringView& line)
+{
+	if (line.length > 1)
+	{
+		switch (line.data[1])
+		{
+		case 'r':
+		{
+			if (!this->hasName())
+			{
+				std::stringstream stream(std::string(line.data + 2, line.length - 2));
+
+				stream >> this->getExtras().resumeToken >> this->extras->resumeSequence;
+
+				this->resuming = !stream.fail();
+			}
+
+			break;
+		}
+		case 'q':
+		{
+			this->quit = true;
+
+			break;
+		}
+		case 'f':
+		{
+			if (!this->hasName() && line.length > 2)
+			{
+				std::string argument(line.data + 2, line.length - 2);
+
+				std::size_t space = argument.find(' ');
+
+				this->getExtras().peerOrigin = argument.substr(0, space);
+
+				if (space != std::string::npos)
+				{
+					this->extras->peerSecret = argument.substr(space + 1);
+				}
+
+				this->peering = true;
+			}
+
+			break;
+		}
+		case 'u':
+		case 'd':
+		{
+			if (!this->hasName() && line.length > 2)
+			{
+				this->getExtras().transferCmd = line.data[1];
+				this->extras->transferArgument = std::string(line.data + 2, line.length - 2);
+			}
+
+			break;
+		}
+		}
+	}
+}
+
+Peer::Peer(const std::string& address) : connection(Connections::None), address(address), outgoing(true), greeted(false), linked(false), live(false), wanted(0), nextAttempt(std::chrono::steady_clock::now()), messageIndex(0)
+{
+
+}
+
+Peer::Peer(Connections::Handle connection, const std::string& origin) : connection(connection), origin(origin), label("[" + origin.substr(0, 8) + "] "), outgoing(false), greeted(false), linked(false), live(false), wanted(0), messageIndex(0)
+{
+
+}
+
+Connections::Handle Peer::getConnection() const
+{
+	return this->connection;
+}
+
+void Peer::setConnection(Connections::Handle connection)
+{
+	this->connection = connection;
+}
+
+bool Peer::isOutgoing() const
+{
+	return this->outgoing;
+}
+
+bool Peer::isConnected() const
+{
+	return this->connection != Connections::None;
+}
+
+bool Peer::shouldConnect() const
+{
+	return this->outgoing && this->connection == Connections::None && !this->connector && std::chrono::steady_clock::now() >= this->nextAttempt;
+}
+
+bool Peer::isConnecting() const
+{
+	return this->connector != nullptr;
+}
+
+void Peer::attempt()
+{
+	this->nextAttempt = std::chrono::steady_clock::now() + RetryDelay;
+}
+
+void Peer::connect()
+{
+	this->connector.reset(new Connector(this->address));
+}
+
+bool Peer::processConnect(Socket& socket)
+{
+	if (!this->connector->process())
+	{
+		return false;
+	}
+
+	socket = this->connector->release();
+
+	this->connector.reset();
+
+	return true;
+}
+
+void Peer::close()
+{
+	this->live = false;
+
+	this->connection = Connections::None;
+
+	this->streams.clear();
+}
+
+const std::string& Peer::getAddress() const
+{
+	return this->address;
+}
+
+const std::string& Peer::getOrigin() const
+{
+	return this->origin;
+}
+
+bool Peer::hasGreeted() const
+{
+	return this->greeted;
+}
+
+bool Peer::hasLinked() const
+{
+	return this->linked;
+}
+
+bool Peer::isLinked() const
+{
+	return this->live;
+}
+
+unsigned long long Peer::getWanted() const
+{
+	return this->wanted;
+}
+
+bool Peer::hasMessage() const
+{
+	return this->messageIndex < this->messages.size();
+}
+
+std::pair<unsigned long long, Message> Peer::getMessage()
+{
+	std::pair<unsigned long long, Message> message(0, Message());
+
+	if (this->messageIndex < this->messages.size())
+	{
+		message = this->messages[this->messageIndex];
+
+		this->messageIndex++;
+	}
+
+	return message;
+}
+
+void Peer::processLine(const StringView& line)
+{
+	this->messages.clear();
+
+	this->messageIndex = 0;
+
+	this->greeted = false;
+
+	this->linked = false;
+
+	if (line.length < 2 || line.data[0] != '\b')
+	{
+		return;
+	}
+
+	switch (line.data[1])
+	{
+	case 'f':
+	{
+		if (line.length > 2)
+		{
+			this->origin = std::string(line.data + 2, line.length - 2);
+
+			this->origin = this->origin.substr(0, this->origin.find(' '));
+
+			this->label = "[" + this->origin.substr(0, 8) + "] ";
+
+			this->greeted = true;
+		}
+
+		break;
+	}
+	case 'w':
+	{
+		this->wanted = std::strtoull(std::string(line.data + 2, line.length - 2).c_str(), nullptr, 10);
+
+		this->linked = true;
+
+		this->live = true;
+
+		break;
+	}
+	case 'm':
+	case 'M':
+	{
+		unsigned long long sequence = 0;
+
+		std::size_t position = 2;
+
+		while (position < line.length && line.data[position] >= '0' && line.data[position] <= '9')
+		{
+			sequence = sequence * 10 + static_cast<unsigned long long>(line.data[position] - '0');
+
+			position++;
+		}
+
+		if (position >= line.length || line.data[position] != ' ')
+		{
+			break;
+		}
+
+		position++;
+
+		StringView body(line.data + position, line.length - position);
+
+		if (line.data[1] == 'm')
+		{
+			this->line = this->label;
+		}
+		else
+		{
+			std::size_t space = static_cast<std::size_t>(std::find(body.data, body.data + body.length, ' ') - body.data);
+
+			if (body.length < 2 || (body.data[0] != 'k' && body.data[0] != 'K') || space == body.length)
+			{
+				break;
+			}
+
+			std::string stream(body.data + 1, space - 1);
+
+			this->line.assign("\b");
+			this->line.append(body.data, space + 1);
+
+			if (this->streams.insert(stream).second)
+			{
+				this->line += this->label;
+			}
+
+			if (body.data[0] == 'K')
+			{
+				this->streams.erase(stream);
+			}
+
+			body = StringView(body.data + space + 1, body.length - space - 1);
+		}
+
+		this->line.append(body.data, body.length);
+
+		this->messages.push_back(std::pair<unsigned long long, Message>(sequence, Message(StringView(), this->line)));
+
+		break;
+	}
+	}
+}
+
+Server::Shard::Shard(std::size_t capacity) : queue(capacity), scheduled(false), users(0)
+{
+
+}
+
+Server::Server(unsigned short port, int backlog, const std::string& control) : handedOff(false), woken(false), spare(Connections::None), events(IngressCapacity), replay(ReplayBytes, ReplayLines), sequence(0), relay(ReplayBytes, ReplayLines), relaySequence(0), nextShard(0), chunkBytes(0), streamed(0)
+{
+	this->origin = this->generateToken();
+
+	for (std::size_t i = 0; i < this->executor.getWorkerCount(); i++)
+	{
+		this->shards.push_back(std::unique_ptr<Shard>(new Shard(EgressCapacity)));
+	}
+
+	if (control.empty() || !this->takeOver(control, backlog))
+	{
+		this->tcpSocket.bind(port);
+
+		this->tcpSocket.listen(backlog);
+	}
+
+	if (!control.empty())
+	{
+		this->handoff.listen(control);
+	}
+
+	this->holding = false;
+
+	this->held = false;
+
+	this->active = false;
+
+	this->roomLimited = false;
+
+	this->run = true;
+
+	this->ingress = std::thread([this]() { this->processIngress(); });
+
+	this->routing = std::thread([this]() { this->processRouting(); });
+}
+
+Server::~Server()
+{
+	this->run = false;
+
+	this->events.close();
+
+	if (this->ingress.joinable())
+	{
+		this->ingress.join();
+	}
+
+	if (this->routing.joinable())
+	{
+		this->routing.join();
+	}
+
+	for (std::size_t i = 0; i < this->connections.getSlotCount() && !this->handedOff; i++)
+	{
+		unsigned char state = this->connections.hot(i).state;
+
+		if ((state == Connection::Open || state == Connection::Closed) && this->connections.at(i).isAttached())
+		{
+			this->connections.at(i).sendCmd('c');
+		}
+	}
+}
+
+void Server::addPeer(const std::string& address)
+{
+	std::lock_guard<std::mutex> lockGuard(this->peerMutex);
+
+	this->pendingPeers.push_back(address);
+}
+
+void Server::setPeerSecret(const std::string& secret)
+{
+	std::lock_guard<std::mutex> lockGuard(this->peerMutex);
+
+	this->peerSecret = secret;
+}
+
+void Server::setFloodLimits(const FloodLimits& limits)
+{
+	std::lock_guard<std::mutex> lockGuard(this->floodMutex);
+
+	this->floodLimits = limits;
+
+	this->roomMessages.configure(limits.roomMessages, std::max(limits.roomMessages * FloodLimits::Burst, 1.0));
+	this->roomBytes.configure(limits.roomBytes, limits.roomBytes * FloodLimits::Burst);
+
+	this->roomLimited = this->roomMessages.isLimited() || this->roomBytes.isLimited();
+}
+
+void Server::setCapture(const std::string& path)
+{
+	std::unique_ptr<Capture> capture(new Capture(path));
+
+	std::lock_guard<std::mutex> lockGuard(this->captureMutex);
+
+	this->pendingCapture = std::move(capture);
+}
+
+void Server::connectLocal(TcpSocket& tcpSocket)
+{
+	Connections::Handle handle = this->connections.allocate();
+
+	Connection& connection = this->connections.hot(Connections::getIndex(handle));
+
+	connection.state = Connection::Reserved;
+
+	User* user = this->connections.get(handle);
+
+	{
+		std::lock_guard<std::mutex> lockGuard(this->floodMutex);
+
+		user->limit(this->floodLimits);
+	}
+
+	user->getSocket().setStreaming(ChunkSize);
+
+	user->getSocket().pair(tcpSocket, [this]() { this->wake(); });
+
+	connection.mode = Connection::Framed;
+	connection.metered = true;
+	connection.deadline = 0;
+
+	connection.state = Connection::Open;
+}
+
+void Server::listenUnix(const std::string& path, int backlog)
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(this->listenMutex);
+
+		if (path == this->unixPath)
+		{
+			return;
+		}
+	}
+
+	std::unique_ptr<TcpSocket> listener(new TcpSocket());
+
+	listener->bind(path);
+
+	listener->listen(backlog);
+
+	std::lock_guard<std::mutex> lockGuard(this->listenMutex);
+
+	this->pendingListener = std::move(listener);
+
+	this->unixPath = path;
+}
+
+bool Server::takeOver(const std::string& control, int backlog)
+{
+	Handoff handoff;
+
+	if (!handoff.connect(control))
+	{
+		return false;
+	}
+
+	try
+	{
+		handoff.receive();
+
+		this->restore(handoff, backlog);
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		this->tcpSocket.detach();
+
+		if (this->unixSocket)
+		{
+			this->unixSocket->detach();
+		}
+
+		throw;
+	}
+
+	handoff.acknowledge();
+
+	return true;
+}
+
+void Server::save(Handoff& handoff, std::vector<Connections::Handle>& handles)
+{
+	handoff.writeString(this->origin);
+
+	handoff.writeNumber(this->sequence);
+	handoff.writeNumber(this->replay.size());
+
+	for (std::size_t i = 0; i < this->replay.size(); i++)
+	{
+		handoff.writeString(this->replay.get(i));
+	}
+
+	handoff.writeNumber(this->relaySequence);
+	handoff.writeNumber(this->relay.size());
+
+	for (std::size_t i = 0; i < this->relay.size(); i++)
+	{
+		handoff.writeString(this->relay.get(i));
+	}
+
+	handoff.writeNumber(this->origins.size());
+
+	for (auto& origin : this->origins)
+	{
+		handoff.writeString(origin.first);
+		handoff.writeNumber(origin.second);
+	}
+
+	this->tcpSocket.save(handoff);
+
+	handoff.writeNumber(this->unixSocket ? 1 : 0);
+
+	if (this->unixSocket)
+	{
+		this->unixSocket->save(handoff);
+	}
+
+	std::unordered_map<Connections::Handle, unsigned long long> saved;
+
+	for (std::size_t i = 0; i < this->connections.getSlotCount(); i++)
+	{
+		Connection& connection = this->connections.hot(i);
+
+		Connections::Handle handle = this->connections.getHandle(i);
+
+		if (connection.state == Connection::Open && connection.mode == Connection::Framed && this->links.find(handle) == this->links.end() && !this->connections.at(i).getSocket().isPaired())
+		{
+			handles.push_back(handle);
+
+			saved[handle] = handles.size();
+		}
+	}
+
+	handoff.writeNumber(handles.size());
+
+	for (Connections::Handle handle : handles)
+	{
+		this->connections.get(handle)->save(handoff);
+	}
+
+	std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+	handoff.writeNumber(this->sessions.size());
+
+	for (auto& entry : this->sessions)
+	{
+		Session& session = entry.second;
+
+		std::unordered_map<Connections::Handle, unsigned long long>::iterator user = saved.find(session.user);
+
+		User* other = this->connections.get(session.user);
+
+		bool timedOut = session.timedOut;
+
+		std::chrono::steady_clock::duration remaining = SessionTimeout;
+
+		if (other == nullptr)
+		{
+			remaining = std::max(session.expiry - now, std::chrono::steady_clock::duration::zero());
+		}
+		else if (user == saved.end())
+		{
+			timedOut = other->hasTimedOut();
+
+			if (other->getSocket().isPaired())
+			{
+				remaining = std::chrono::steady_clock::duration::zero();
+			}
+		}
+
+		handoff.writeString(entry.first);
+		handoff.writeString(session.identity->name);
+
+		handoff.writeNumber(user != saved.end() ? user->second : 0);
+
+		handoff.writeNumber(timedOut ? 1 : 0);
+
+		handoff.writeNumber(static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count()));
+	}
+}
+
+void Server::restore(Handoff& handoff, int backlog)
+{
+	this->origin = handoff.readString();
+
+	this->sequence = handoff.readNumber();
+
+	unsigned long long count = handoff.readNumber();
+
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		this->replay.push(handoff.readString());
+	}
+
+	this->relaySequence = handoff.readNumber();
+
+	count = handoff.readNumber();
+
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		this->relay.push(handoff.readString());
+	}
+
+	count = handoff.readNumber();
+
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		std::string origin = handoff.readString();
+
+		this->origins[origin] = handoff.readNumber();
+	}
+
+	this->tcpSocket.restore(handoff);
+
+	this->tcpSocket.listen(backlog);
+
+	if (handoff.readNumber() != 0)
+	{
+		this->unixSocket.reset(new TcpSocket());
+
+		this->unixSocket->restore(handoff);
+
+		this->unixSocket->listen(backlog);
+
+		this->unixPath = this->unixSocket->getPath();
+	}
+
+	std::vector<Connections::Handle> handles;
+
+	count = handoff.readNumber();
+
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		Connections::Handle handle = this->connections.allocate();
+
+		Connection& connection = this->connections.hot(Connections::getIndex(handle));
+
+		connection.state = Connection::Reserved;
+
+		handles.push_back(handle);
+
+		User* user = this->connections.get(handle);
+
+		user->restore(handoff, this->identities);
+
+		if (user->isAttached())
+		{
+			user->setShard(this->nextShard++ % this->shards.size());
+
+			this->shards[user->getShard()]->users++;
+
+			this->shards[user->getShard()]->recipients.push_back(handle);
+		}
+
+		connection.mode = Connection::Framed;
+		connection.metered = true;
+		connection.deadline = 0;
+
+		connection.state = Connection::Open;
+	}
+
+	std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+	count = handoff.readNumber();
+
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		Session& session = this->sessions[handoff.readString()];
+
+		session.identity = this->identities.intern(handoff.readString());
+
+		unsigned long long user = handoff.readNumber();
+
+		if (user > handles.size())
+		{
+			throw std::runtime_error("Malformed handoff state");
+		}
+
+		session.user = user > 0 ? handles[static_cast<std::size_t>(user - 1)] : Connections::None;
+
+		session.timedOut = handoff.readNumber() != 0;
+
+		session.expiry = now + std::chrono::milliseconds(handoff.readNumber());
+	}
+}
+
+bool Server::acceptUser()
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(this->listenMutex);
+
+		if (this->pendingListener)
+		{
+			this->unixSocket = std::move(this->pendingListener);
+		}
+	}
+
+	bool accepted = false;
+
+	for (std::size_t i = 0; i < AcceptBatch; i++)
+	{
+		if (this->spare == Connections::None)
+		{
+			this->spare = this->connections.allocate();
+
+			this->connections.hot(Connections::getIndex(this->spare)).state = Connection::Reserved;
+		}
+
+		User* user = this->connections.get(this->spare);
+
+		if (!this->acceptUser(*user))
+		{
+			break;
+		}
+
+		{
+			std::lock_guard<std::mutex> lockGuard(this->floodMutex);
+
+			user->limit(this->floodLimits);
+		}
+
+		user->getSocket().setStreaming(ChunkSize);
+
+		Connection& connection = this->connections.hot(Connections::getIndex(this->spare));
+
+		connection.mode = Connection::Framed;
+		connection.metered = true;
+		connection.deadline = 0;
+
+		connection.state = Connection::Open;
+
+		this->spare = Connections::None;
+
+		accepted = true;
+	}
+
+	return accepted;
+}
+
+bool Server::acceptUser(User& user)
+{
+	if (this->tcpSocket.accept(user.getSocket()))
+	{
+		return true;
+	}
+
+	return this->unixSocket && this->unixSocket->accept(user.getSocket());
+}
+
+void Server::wake()
+{
+	std::lock_guard<std::mutex> lockGuard(this->wakeMutex);
+
+	this->woken = true;
+
+	this->wakeCondition.notify_one();
+}
+
+bool Server::admitLine(User& user, const StringView& line, const std::chrono::steady_clock::time_point& now, std::chrono::steady_clock::duration& wait)
+{
+	double bytes = static_cast<double>(line.length + 1);
+
+	TokenBucket& messageBucket = user.getMessageBucket();
+	TokenBucket& byteBucket = user.getByteBucket();
+
+	if (!messageBucket.consume(1.0, now))
+	{
+		wait = messageBucket.getWait(1.0);
+
+		return false;
+	}
+
+	if (!byteBucket.consume(bytes, now))
+	{
+		messageBucket.refund(1.0);
+
+		wait = byteBucket.getWait(bytes);
+
+		return false;
+	}
+
+	if (this->roomLimited)
+	{
+		std::lock_guard<std::mutex> lockGuard(this->floodMutex);
+
+		if (!this->roomMessages.consume(1.0, now))
+		{
+			messageBucket.refund(1.0);
+			byteBucket.refund(bytes);
+
+			wait = this->roomMessages.getWait(1.0);
+
+			return false;
+		}
+
+		if (!this->roomBytes.consume(bytes, now))
+		{
+			this->roomMessages.refund(1.0);
+
+			messageBucket.refund(1.0);
+			byteBucket.refund(bytes);
+
+			wait = this->roomBytes.getWait(bytes);
+
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Server::pushEvent(Event& event, Event::Type type, Connections::Handle user, const StringView& line, TcpSocket::Fragment fragment, bool wait)
+{
+	std::size_t command = fragment == TcpSocket::Whole && line.length > 0 && line.data[0] == '\b' ? 1 : 0;
+
+	event.type = type;
+	event.user = user;
+	event.line.assign(line.data, command);
+	event.fragment = fragment;
+	event.time = std::chrono::steady_clock::now();
+
+	if (Sanitizer::sanitize(line.data + command, line.length - command, event.line))
+	{
+		Metrics::count(Metrics::SanitizedLines);
+	}
+
+	event.streamed = fragment != TcpSocket::Whole ? event.line.length() : 0;
+
+	this->streamed += event.streamed;
+
+	std::size_t streamed = event.streamed;
+
+	bool pushed = wait ? this->events.push(event) : this->events.tryPush(event);
+
+	if (!pushed)
+	{
+		this->streamed -= streamed;
+	}
+
+	Metrics::set(Metrics::IngressQueueDepth, this->events.size());
+
+	return pushed;
+}
+
+void Server::pushDelivery(std::size_t shard, Delivery::Type type, Connections::Handle user, char cmd, const StringView& line)
+{
+	this->delivery.type = type;
+	this->delivery.user = user;
+	this->delivery.cmd = cmd;
+	this->delivery.sender.reset();
+	this->delivery.line.assign(line.data, line.length);
+	this->delivery.split = line.length;
+
+	this->enqueueDelivery(shard);
+}
+
+void Server::enqueueDelivery(std::size_t shard)
+{
+	this->delivery.streamed = this->chunkBytes;
+
+	this->streamed += this->chunkBytes;
+
+	this->shards[shard]->queue.push(this->delivery);
+
+	Metrics::set(Metrics::EgressQueueDepth, this->shards[shard]->queue.size());
+
+	this->scheduleShard(shard);
+}
+
+void Server::scheduleShard(std::size_t shard)
+{
+	if (!this->shards[shard]->scheduled.exchange(true))
+	{
+		this->executor.submit([this, shard]() { this->processShard(shard); });
+	}
+}
+
+void Server::sendLine(Connections::Handle user, const StringView& line)
+{
+	this->pushDelivery(this->connections.get(user)->getShard(), Delivery::Unicast, user, 0, line);
+}
+
+void Server::sendCmd(Connections::Handle user, char cmd, const StringView& argument)
+{
+	this->pushDelivery(this->connections.get(user)->getShard(), Delivery::Command, user, cmd, argument);
+}
+
+void Server::deliverMessage(const Message& message)
+{
+	this->replay.push({ message.prefix, message.body });
+
+	this->sequence++;
+
+	for (std::size_t i = 0; i < this->shards.size(); i++)
+	{
+		if (this->shards[i]->users == 0)
+		{
+			continue;
+		}
+
+		this->delivery.type = Delivery::Broadcast;
+		this->delivery.user = Connections::None;
+		this->delivery.cmd = 0;
+		this->delivery.sender = message.sender;
+
+		if (message.sender)
+		{
+			this->delivery.line.assign(message.body.data, message.body.length);
+			this->delivery.split = 0;
+		}
+		else
+		{
+			this->delivery.line.assign(message.prefix.data, message.prefix.length);
+			this->delivery.line.append(message.body.data, message.body.length);
+			this->delivery.split = this->delivery.line.length();
+		}
+
+		this->enqueueDelivery(i);
+	}
+}
+
+void Server::writeMessage(const Message& message)
+{
+	this->deliverMessage(message);
+
+	this->relay.push({ message.prefix, message.body });
+
+	this->relaySequence++;
+
+	for (auto& peer : this->peers)
+	{
+		if (peer->isLinked())
+		{
+			this->relayMessage(peer, this->relaySequence, message);
+		}
+	}
+}
+
+void Server::relayMessage(const std::shared_ptr<Peer>& peer, unsigned long long sequence, const Message& message)
+{
+	char number[24];
+
+	int length = std::snprintf(number, sizeof(number), "\bm%llu ", sequence);
+
+	this->delivery.type = Delivery::Unicast;
+	this->delivery.user = peer->getConnection();
+	this->delivery.cmd = 0;
+	this->delivery.sender = message.sender;
+	this->delivery.line.assign(number, static_cast<std::size_t>(length));
+
+	if (message.sender)
+	{
+		this->delivery.line.append(message.body.data, message.body.length);
+		this->delivery.split = static_cast<std::size_t>(length);
+	}
+	else
+	{
+		this->delivery.line.append(message.prefix.data, message.prefix.length);
+		this->delivery.line.append(message.body.data, message.body.length);
+
+		if (this->delivery.line.length() > static_cast<std::size_t>(length) && this->delivery.line[length] == '\b')
+		{
+			this->delivery.line[1] = 'M';
+
+			this->delivery.line.erase(static_cast<std::size_t>(length), 1);
+		}
+
+		this->delivery.split = this->delivery.line.length();
+	}
+
+	this->enqueueDelivery(this->connections.get(peer->getConnection())->getShard());
+}
+
+std::string Server::generateToken()
+{
+	std::vector<unsigned char> bytes(TokenBytes);
+
+	#if defined(WINDOWS)
+
+	if (BCryptGenRandom(nullptr, bytes.data(), static_cast<ULONG>(bytes.size()), BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0)
+	{
+		throw std::runtime_error("Could not generate a token");
+	}
+
+	#elif defined(POSIX)
+
+	int file = ::open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+
+	if (file < 0)
+	{
+		throw std::runtime_error("Could not generate a token");
+	}
+
+	std::size_t count = 0;
+
+	while (count < bytes.size())
+	{
+		ssize_t result = ::read(file, bytes.data() + count, bytes.size() - count);
+
+		if (result > 0)
+		{
+			count += static_cast<std::size_t>(result);
+		}
+		else if (result == 0 || errno != EINTR)
+		{
+			::close(file);
+
+			throw std::runtime_error("Could not generate a token");
+		}
+	}
+
+	::close(file);
+
+	#endif
+
+	static const char digits[] = "0123456789abcdef";
+
+	std::string token(bytes.size() * 2, '0');
+
+	for (std::size_t i = 0; i < bytes.size(); i++)
+	{
+		token[i * 2] = digits[bytes[i] >> 4];
+		token[i * 2 + 1] = digits[bytes[i] & 0x0F];
+	}
+
+	return token;
+}
+
+void Server::attachUser(Connections::Handle handle)
+{
+	User* user = this->connections.get(handle);
+
+	user->setShard(this->nextShard++ % this->shards.size());
+
+	user->setAttached(true);
+
+	this->shards[user->getShard()]->users++;
+
+	this->pushDelivery(user->getShard(), Delivery::Attach, handle, 0, StringView());
+}
+
+void Server::detachUser(Connections::Handle handle)
+{
+	User* user = this->connections.get(handle);
+
+	if (user->isAttached())
+	{
+		user->setAttached(false);
+
+		this->shards[user->getShard()]->users--;
+
+		this->pushDelivery(user->getShard(), Delivery::Detach, handle, 0, StringView());
+	}
+}
+
+void Server::createSession(Connections::Handle handle)
+{
+	User* user = this->connections.get(handle);
+
+	std::string token = this->generateToken();
+
+	Session& session = this->sessions[token];
+
+	session.identity = user->getIdentity();
+	session.user = handle;
+	session.timedOut = false;
+
+	user->setToken(token);
+
+	this->sendCmd(handle, 's', token + " " + std::to_string(this->sequence));
+}
+
+void Server::resumeSession(Connections::Handle handle)
+{
+	User* user = this->connections.get(handle);
+
+	std::unordered_map<std::string, Session>::iterator iter = this->sessions.find(user->getResumeToken());
+
+	if (iter == this->sessions.end())
+	{
+		user->reject();
+
+		this->sendCmd(handle, 'n');
+
+		return;
+	}
+
+	Session& session = iter->second;
+
+	User* other = this->connections.get(session.user);
+
+	if (other && session.user != handle)
+	{
+		other->replace();
+	}
+
+	session.user = handle;
+
+	user->resume(session.identity, iter->first);
+
+	unsigned long long oldest = this->sequence - this->replay.size() + 1;
+	unsigned long long start = std::min(std::max(user->getResumeSequence() + 1, oldest), this->sequence + 1);
+
+	this->sendCmd(handle, 's', iter->first + " " + std::to_string(start - 1));
+
+	for (unsigned long long i = start; i <= this->sequence; i++)
+	{
+		this->sendLine(handle, this->replay.get(static_cast<std::size_t>(i - oldest)));
+	}
+}
+
+void Server::closeSession(Connections::Handle handle)
+{
+	User* user = this->connections.get(handle);
+
+	if (!user->hasName() || user->isReplaced())
+	{
+		return;
+	}
+
+	std::unordered_map<std::string, Session>::iterator iter = this->sessions.find(user->getToken());
+
+	if (iter == this->sessions.end() || user->hasQuit())
+	{
+		this->writeMessage(Message(user->getName(), " left the chat room"));
+
+		if (iter != this->sessions.end())
+		{
+			this->sessions.erase(iter);
+		}
+	}
+	else if (iter->second.user == handle)
+	{
+		iter->second.user = Connections::None;
+		iter->second.timedOut = user->hasTimedOut();
+		iter->second.expiry = std::chrono::steady_clock::now() + SessionTimeout;
+	}
+}
+
+void Server::expireSessions()
+{
+	std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+	std::unordered_map<std::string, Session>::iterator iter;
+
+	for (iter = this->sessions.begin(); iter != this->sessions.end(); )
+	{
+		Session& session = iter->second;
+
+		if (session.user == Connections::None && session.expiry <= now)
+		{
+			this->writeMessage(Message(session.identity->name, session.timedOut ? " timed out" : " left the chat room"));
+
+			iter = this->sessions.erase(iter);
+
+			continue;
+		}
+
+		iter++;
+	}
+}
+
+void Server::openTransfer(Connections::Handle handle)
+{
+	User* user = this->connections.get(handle);
+
+	std::stringstream stream(user->getTransferArgument());
+
+	std::shared_ptr<Transfer> transfer;
+
+	if (user->getTransferCmd() == 'u')
+	{
+		std::string token;
+		unsigned long long size = 0;
+		std::string name;
+
+		stream >> token >> size >> name;
+
+		std::unordered_map<std::string, Session>::iterator iter = this->sessions.find(token);
+
+		if (!stream.fail() && iter != this->sessions.end() && size <= Transfer::MaxSize)
+		{
+			unsigned long long spooled = 0;
+
+			bool sending = false;
+
+			for (const std::pair<const std::string, Offer>& entry : this->offers)
+			{
+				spooled += entry.second.transfer->getSize();
+
+				if (entry.second.session == token && !entry.second.transfer->isFinished())
+				{
+					sending = true;
+				}
+			}
+
+			if (sending || spooled + size > SpoolBudget)
+			{
+				user->sendCmd('e', sending ? "Another file transfer is still in progress" : "The server has no room for this file right now");
+
+				user->close();
+
+				return;
+			}
+
+			try
+			{
+				transfer = std::make_shared<Transfer>(this->generateToken(), iter->second.identity->name, Transfer::getFileName(name), size);
+
+				Offer& offer = this->offers[transfer->getId()];
+
+				offer.transfer = transfer;
+				offer.session = token;
+				offer.expiry = std::chrono::steady_clock::now() + TransferRetention;
+
+				this->offerTransfer(transfer, iter->second.user);
+			}
+			catch (const std::runtime_error& runtimeError)
+			{
+
+			}
+		}
+	}
+	else if (user->getTransferCmd() == 'd')
+	{
+		std::string id;
+
+		stream >> id;
+
+		std::unordered_map<std::string, Offer>::iterator iter = this->offers.find(id);
+
+		if (iter != this->offers.end() && !iter->second.transfer->hasFailed())
+		{
+			transfer = iter->second.transfer;
+		}
+	}
+
+	if (!transfer)
+	{
+		user->close();
+
+		return;
+	}
+
+	Connection& connection = this->connections.hot(Connections::getIndex(handle));
+
+	connection.metered = false;
+
+	user->getSocket().setStreaming(0);
+
+	this->detachUser(handle);
+
+	user->setTransfer(transfer);
+
+	connection.mode = Connection::Raw;
+
+	if (user->getTransferCmd() == 'u')
+	{
+		user->sendCmd('u', transfer->getId());
+	}
+}
+
+void Server::offerTransfer(const std::shared_ptr<Transfer>& transfer, Connections::Handle sender)
+{
+	std::string line = "\bo" + transfer->getId() + " " + std::to_string(transfer->getSize()) + " " + transfer->getName() + " " + transfer->getSender();
+
+	for (std::size_t i = 0; i < this->shards.size(); i++)
+	{
+		if (this->shards[i]->users == 0)
+		{
+			continue;
+		}
+
+		this->delivery.type = Delivery::Broadcast;
+		this->delivery.user = sender;
+		this->delivery.cmd = 0;
+		this->delivery.sender.reset();
+		this->delivery.line = line;
+		this->delivery.split = line.length();
+
+		this->enqueueDelivery(i);
+	}
+}
+
+void Server::expireOffers()
+{
+	std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+	std::unordered_map<std::string, Offer>::iterator iter;
+
+	for (iter = this->offers.begin(); iter != this->offers.end(); )
+	{
+		Offer& offer = iter->second;
+
+		if (!offer.transfer->isFinished())
+		{
+			offer.expiry = now + TransferRetention;
+		}
+		else if (offer.expiry <= now)
+		{
+			iter = this->offers.erase(iter);
+
+			continue;
+		}
+
+		iter++;
+	}
+}
+
+void Server::captureEvent(const Event& event)
+{
+	if (this->links.find(event.user) != this->links.end() || this->connections.hot(Connections::getIndex(event.user)).mode != Connection::Framed)
+	{
+		return;
+	}
+
+	Capture::Type type = Capture::Close;
+
+	if (event.type == Event::Line)
+	{
+		type = event.fragment == TcpSocket::Head || event.fragment == TcpSocket::Body ? Capture::Part : Capture::Line;
+	}
+
+	this->capture->record(event.user, type, event.line, event.time);
+}
+
+void Server::flushCapture()
+{
+	{
+		std::lock_guard<std::mutex> lockGuard(this->captureMutex);
+
+		if (this->pendingCapture)
+		{
+			this->capture = std::move(this->pendingCapture);
+		}
+	}
+
+	if (this->capture)
+	{
+		this->capture->flush();
+	}
+}
+
+void Server::processLine(Connections::Handle handle, const StringView& line, TcpSocket::Fragment fragment)
+{
+	std::unordered_map<Connections::Handle, std::shared_ptr<Peer>>::iterator link = this->links.find(handle);
+
+	if (link != this->links.end())
+	{
+		this->processPeerLine(link->second, line);
+
+		return;
+	}
+
+	if (fragment != TcpSocket::Whole)
+	{
+		this->processChunk(handle, line, fragment != TcpSocket::Tail);
+
+		return;
+	}
+
+	User* user = this->connections.get(handle);
+
+	if (user->isTransferring())
+	{
+		return;
+	}
+
+	user->processLine(this->identities, line);
+
+	if (this->connections.hot(Connections::getIndex(handle)).mode != Connection::Framed)
+	{
+		this->openTransfer(handle);
+
+		return;
+	}
+
+	if (user->isPeering())
+	{
+		if (!this->isTrustedPeer(user->getPeerSecret()))
+		{
+			Metrics::count(Metrics::RejectedPeers);
+
+			user->close();
+
+			return;
+		}
+
+		std::shared_ptr<Peer> peer(new Peer(handle, user->getPeerOrigin()));
+
+		this->connections.hot(Connections::getIndex(handle)).metered = false;
+
+		user->getSocket().setStreaming(0);
+
+		this->detachUser(handle);
+
+		this->peers.push_back(peer);
+
+		this->links[handle] = peer;
+
+		this->greetPeer(peer);
+
+		return;
+	}
+
+	if (!user->isAttached())
+	{
+		this->attachUser(handle);
+	}
+
+	if (user->isResuming())
+	{
+		this->resumeSession(handle);
+	}
+
+	if (user->hasJoined())
+	{
+		this->createSession(handle);
+	}
+
+	while (user->hasMessage())
+	{
+		this->writeMessage(user->getMessage());
+	}
+}
+
+void Server::processChunk(Connections::Handle handle, const StringView& line, bool more)
+{
+	User* user = this->connections.get(handle);
+
+	if (!user->hasName())
+	{
+		user->close();
+
+		return;
+	}
+
+	bool first = !user->isStreaming();
+
+	if (first)
+	{
+		user->setStream(this->generateToken());
+	}
+
+	this->chunkPrefix.assign(1, '\b');
+	this->chunkPrefix += more ? 'k' : 'K';
+	this->chunkPrefix += user->getStream();
+	this->chunkPrefix += ' ';
+
+	if (first)
+	{
+		this->chunkPrefix += user->getPrefix();
+	}
+
+	this->chunkBytes = line.length;
+
+	this->writeMessage(Message(this->chunkPrefix, line));
+
+	this->chunkBytes = 0;
+
+	if (!more)
+	{
+		user->setStream(std::string());
+	}
+}
+
+void Server::processDisconnect(Connections::Handle handle)
+{
+	std::unordered_map<Connections::Handle, std::shared_ptr<Peer>>::iterator link = this->links.find(handle);
+
+	if (link != this->links.end())
+	{
+		link->second->close();
+
+		this->links.erase(link);
+	}
+	else
+	{
+		if (this->connections.get(handle)->isStreaming())
+		{
+			this->processChunk(handle, StringView(), false);
+		}
+
+		this->detachUser(handle);
+
+		this->closeSession(handle);
+	}
+
+	this->pushDelivery(this->connections.get(handle)->getShard(), Delivery::Release, handle, 0, StringView());
+}
+
+void Server::connectPeer(const std::shared_ptr<Peer>& peer)
+{
+	Socket socket = INVALID_SOCKET;
+
+	if (!peer->processConnect(socket) || socket == INVALID_SOCKET)
+	{
+		return;
+	}
+
+	Connections::Handle handle = this->connections.allocate();
+
+	Connection& connection = this->connections.hot(Connections::getIndex(handle));
+
+	connection.state = Connection::Reserved;
+
+	User* user = this->connections.get(handle);
+
+	std::string greeting = this->origin;
+
+	{
+		std::lock_guard<std::mutex> lockGuard(this->peerMutex);
+
+		if (!this->peerSecret.empty())
+		{
+			greeting += " " + this->peerSecret;
+		}
+	}
+
+	try
+	{
+		user->getSocket().attach(socket);
+
+		user->getSocket().setNonBlocking();
+
+		user->sendCmd('f', greeting);
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		user->reset();
+
+		connection.state = Connection::Free;
+
+		this->connections.release(handle);
+
+		return;
+	}
+
+	user->setShard(this->nextShard++ % this->shards.size());
+
+	peer->setConnection(handle);
+
+	this->links[handle] = peer;
+
+	connection.mode = Connection::Framed;
+	connection.metered = false;
+	connection.deadline = 0;
+
+	connection.state = Connection::Open;
+}
+
+void Server::greetPeer(const std::shared_ptr<Peer>& peer)
+{
+	if (peer->getOrigin() == this->origin)
+	{
+		this->connections.get(peer->getConnection())->close();
+
+		return;
+	}
+
+	if (!peer->isOutgoing())
+	{
+		this->sendCmd(peer->getConnection(), 'f', this->origin);
+	}
+
+	this->sendCmd(peer->getConnection(), 'w', std::to_string(this->origins[peer->getOrigin()]));
+}
+
+void Server::linkPeer(const std::shared_ptr<Peer>& peer)
+{
+	unsigned long long oldest = this->relaySequence - this->relay.size() + 1;
+	unsigned long long start = std::min(std::max(peer->getWanted() + 1, oldest), this->relaySequence + 1);
+
+	for (unsigned long long i = start; i <= this->relaySequence; i++)
+	{
+		std::string line = this->relay.get(static_cast<std::size_t>(i - oldest));
+
+		this->relayMessage(peer, i, Message(StringView(), line));
+	}
+}
+
+void Server::processPeerLine(const std::shared_ptr<Peer>& peer, const StringView& line)
+{
+	peer->processLine(line);
+
+	if (peer->hasGreeted())
+	{
+		this->greetPeer(peer);
+	}
+
+	if (peer->hasLinked())
+	{
+		this->linkPeer(peer);
+	}
+
+	while (peer->hasMessage())
+	{
+		unsigned long long& delivered = this->origins[peer->getOrigin()];
+
+		std::pair<unsigned long long, Message> message = peer->getMessage();
+
+		if (message.first > delivered)
+		{
+			delivered = message.first;
+
+			this->deliverMessage(message.second);
+
+			Metrics::count(Metrics::RelayedMessages);
+		}
+		else
+		{
+			Metrics::count(Metrics::DuplicateMessages);
+		}
+	}
+}
+
+void Server::processPeers()
 {
-	if (this->tcpSocket)
 	{
-		return this->tcpSocket->isConnected();
+		std::lock_guard<std::mutex> lockGuard(this->peerMutex);
+
+		for (auto& address : this->pendingPeers)
+		{
+			this->peers.push_back(std::shared_ptr<Peer>(new Peer(address)));
+		}
+
+		this->pendingPeers.clear();
 	}
 
-	return false;
-}
+	std::vector<std::shared_ptr<Peer>>::iterator iter;
 
-bool User::hasName() const
-{
-	return this->name != "";
-}
+	for (iter = this->peers.begin(); iter != this->peers.end(); )
+	{
+		std::shared_ptr<Peer>& peer = *iter;
 
-std::string User::getName()
-{
-	return this->name;
-}
+		if (peer->shouldConnect())
+		{
+			peer->attempt();
 
-bool User::hasMessage() const
-{
-	return this->messages.size() > 0;
+			try
+			{
+				peer->connect();
+			}
+			catch (const std::runtime_error& runtimeError)
+			{
+
+			}
+		}
+
+		if (peer->isConnecting())
+		{
+			this->connectPeer(peer);
+		}
+
+		if (!peer->isConnected() && (!peer->isOutgoing() || peer->getOrigin() == this->origin))
+		{
+			iter = this->peers.erase(iter);
+
+			continue;
+		}
+
+		iter++;
+	}
 }
 
-std::string User::getMessage()
+bool Server::isTrustedPeer(const std::string& secret)
 {
-	std::string str;
+	std::lock_guard<std::mutex> lockGuard(this->peerMutex);
 
-	if (this->messages.size() > 0)
+	if (this->peerSecret.empty())
 	{
-		str = this->messages.front();
+		return false;
+	}
+
+	unsigned char difference = secret.length() == this->peerSecret.length() ? 0 : 1;
 
-		this->messages.pop();
+	for (std::size_t i = 0; i < this->peerSecret.length(); i++)
+	{
+		difference |= static_cast<unsigned char>(this->peerSecret[i] ^ (i < secret.length() ? secret[i] : 0));
 	}
 
-	return str;
+	return difference == 0;
 }
 
-void User::sendMessage(const std::string& message)
+void Server::processConnection(std::size_t index)
 {
-	if (this->tcpSocket)
+	static thread_local Event event;
+
+	if (this->connections.hot(index).mode != Connection::Framed)
 	{
-		this->tcpSocket->writeLine(message);
+		this->processTransfer(index);
+
+		return;
 	}
-}
 
-void User::process()
-{
-	if (this->tcpSocket)
+	User& user = this->connections.at(index);
+
+	Connection& connection = this->connections.hot(index);
+
+	Connections::Handle handle = this->connections.getHandle(index);
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	std::chrono::steady_clock::duration wait;
+
+	StringView line;
+
+	TcpSocket::Fragment fragment = TcpSocket::Whole;
+
+	bool progress = true;
+	bool stalled = false;
+
+	for (std::size_t i = 0; i < ReceiveBatch && progress && !stalled; i++)
 	{
-		this->tcpSocket->process();
+		user.process();
 
-		while (this->tcpSocket->hasLine())
-		{
-			this->processMessage(this->tcpSocket->readLine());
-		}
+		progress = false;
 
-		if (this->hasName())
+		while (!stalled && user.readLine(line, fragment))
 		{
-			if (this->tcpSocket->hasTimedOut())
+			if (fragment != TcpSocket::Whole && this->streamed >= StreamBudget)
+			{
+				user.unreadLine();
+
+				stalled = true;
+
+				break;
+			}
+
+			if (connection.metered && !this->admitLine(user, line, now, wait))
+			{
+				if (user.getFloodAction() == FloodLimits::Delay)
+				{
+					user.unreadLine();
+
+					connection.deadline = (now + wait).time_since_epoch().count();
+
+					Metrics::count(Metrics::ThrottledLines);
+
+					stalled = true;
+
+					break;
+				}
+
+				if (user.getFloodAction() == FloodLimits::Drop)
+				{
+					if (!user.isFlooding())
+					{
+						user.sendCmd('t');
+
+						user.setFlooding(true);
+					}
+
+					Metrics::count(Metrics::DroppedLines);
+
+					progress = true;
+
+					continue;
+				}
+
+				user.sendCmd('c');
+
+				user.close();
+
+				while (user.readLine(line, fragment))
+				{
+
+				}
+
+				Metrics::count(Metrics::FloodDisconnects);
+
+				stalled = true;
+
+				break;
+			}
+
+			if (!this->pushEvent(event, Event::Line, handle, line, fragment, false))
 			{
-				this->messages.push(this->name + " timed out");
+				user.unreadLine();
 
-				this->tcpSocket->close();
+				stalled = true;
+
+				break;
 			}
-			else if (!this->tcpSocket->isConnected())
+
+			user.setFlooding(false);
+
+			progress = true;
+
+			this->active = true;
+
+			if (line.length > 1 && line.data[0] == '\b' && (line.data[1] == 'u' || line.data[1] == 'd'))
 			{
-				this->messages.push(this->name + " left the chat room");
+				connection.mode = Connection::Pending;
+
+				stalled = true;
+
+				break;
 			}
 		}
 	}
+
+	if (!user.isConnected() && !user.hasLine())
+	{
+		connection.state = Connection::Closed;
+	}
+
+	connection.scheduled = false;
+}
+
+void Server::processTransfer(std::size_t index)
+{
+	User& user = this->connections.at(index);
+
+	Connection& connection = this->connections.hot(index);
+
+	if (connection.mode == Connection::Raw && user.processTransfer())
+	{
+		this->active = true;
+	}
+
+	if (!user.isConnected())
+	{
+		connection.state = Connection::Closed;
+	}
+
+	connection.scheduled = false;
 }
 
-void User::processMessage(const std::string& line)
+void Server::processEvent(Event& event)
 {
-	if (line.length() > 0)
+	Metrics::set(Metrics::IngressQueueDepth, this->events.size());
+
+	Metrics::set(Metrics::IngressLatency, static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - event.time).count()));
+
+	switch (event.type)
 	{
-		if (!this->hasName())
+	case Event::Line:
+	{
+		if (this->capture)
 		{
-			this->name = line;
+			this->captureEvent(event);
+		}
 
-			this->messages.push(this->name + " joined the chat room");
+		this->processLine(event.user, event.line, event.fragment);
+
+		this->streamed -= event.streamed;
+
+		if (event.line.capacity() > LineCapacity)
+		{
+			std::string().swap(event.line);
 		}
-		else
+
+		break;
+	}
+	case Event::Disconnected:
+	{
+		if (this->capture)
 		{
-			this->messages.push(this->name + ": " + line);
+			this->captureEvent(event);
 		}
+
+		this->processDisconnect(event.user);
+
+		break;
+	}
 	}
 }
 
-Server::Server(unsigned short port)
+void Server::quiesce()
 {
-	this->tcpSocket.bind(port);
+	Event event;
 
-	this->tcpSocket.listen();
+	this->held = false;
 
-	this->run = true;
+	this->holding = true;
+
+	this->wake();
+
+	while (this->run && !this->held)
+	{
+		if (this->events.pop(event, std::chrono::milliseconds(0)))
+		{
+			this->processEvent(event);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
 
-	this->thread = std::thread([this]() { this->processNetwork(); });
+	for (std::size_t i = 0; i < this->connections.getSlotCount(); i++)
+	{
+		while (this->connections.hot(i).scheduled)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	while (this->events.pop(event, std::chrono::milliseconds(0)))
+	{
+		this->processEvent(event);
+	}
+
+	for (auto& shard : this->shards)
+	{
+		while (shard->scheduled || shard->queue.size() > 0)
+		{
+			std::this_thread::yield();
+		}
+	}
 }
 
-Server::~Server()
+void Server::processHandoff()
 {
-	this->run = false;
+	if (!this->handoff.accept())
+	{
+		return;
+	}
+
+	this->quiesce();
+
+	std::vector<Connections::Handle> handles;
+
+	try
+	{
+		if (this->run)
+		{
+			this->save(this->handoff, handles);
+
+			this->handoff.send();
+		}
+
+		if (this->run && this->handoff.isAcknowledged())
+		{
+			for (Connections::Handle handle : handles)
+			{
+				this->connections.get(handle)->getSocket().detach();
+			}
+
+			this->tcpSocket.detach();
+
+			if (this->unixSocket)
+			{
+				this->unixSocket->detach();
+			}
+
+			for (std::size_t i = 0; i < this->connections.getSlotCount(); i++)
+			{
+				unsigned char state = this->connections.hot(i).state;
+
+				if (state == Connection::Open || state == Connection::Closed)
+				{
+					this->connections.at(i).close();
+				}
+			}
+
+			this->handoff.close();
 
-	if (this->thread.joinable())
+			this->handedOff = true;
+
+			this->run = false;
+
+			return;
+		}
+	}
+	catch (const std::runtime_error& runtimeError)
 	{
-		this->thread.join();
+
 	}
+
+	this->handoff.disconnect();
+
+	this->holding = false;
+
+	this->wake();
 }
 
-void Server::acceptUser()
+void Server::processIngress()
 {
-	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
-
-	while (this->tcpSocket.isAvailable())
+	while (this->run)
 	{
-		this->users.push_back(std::shared_ptr<User>(new User(this->tcpSocket.accept())));
+		bool accepted = false;
+
+		if (this->holding)
+		{
+			this->held = true;
+		}
+		else
+		{
+			accepted = this->acceptUser();
+
+			std::size_t slots = this->connections.getSlotCount();
+
+			std::chrono::steady_clock::rep now = std::chrono::steady_clock::now().time_since_epoch().count();
+
+			for (std::size_t i = 0; i < slots; i++)
+			{
+				Connection& connection = this->connections.hot(i);
+
+				unsigned char state = connection.state;
+
+				if (state == Connection::Open && connection.deadline <= now && !connection.scheduled.exchange(true))
+				{
+					this->executor.submit([this, i]() { this->processConnection(i); });
+				}
+				else if (state == Connection::Closed && !connection.scheduled)
+				{
+					connection.state = Connection::Closing;
+
+					this->pushEvent(this->event, Event::Disconnected, this->connections.getHandle(i), StringView(), TcpSocket::Whole, true);
+				}
+			}
+		}
+
+		if (!accepted && !this->active.exchange(false))
+		{
+			std::unique_lock<std::mutex> lock(this->wakeMutex);
+
+			this->wakeCondition.wait_for(lock, Tick, [this]() { return this->woken; });
+
+			this->woken = false;
+		}
 	}
 }
 
-void Server::writeMessage(const std::string& message)
+void Server::processRouting()
 {
-	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+	Event event;
+
+	std::chrono::time_point<std::chrono::steady_clock> housekeeping = std::chrono::steady_clock::now();
 
-	for (auto& user : this->users)
+	while (this->run)
 	{
-		if (user)
+		if (this->events.pop(event, Tick))
+		{
+			this->processEvent(event);
+		}
+
+		std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+		if (now - housekeeping >= Tick)
 		{
-			user->sendMessage(message);
+			this->processPeers();
+
+			this->expireSessions();
+
+			this->expireOffers();
+
+			this->flushCapture();
+
+			this->processHandoff();
+
+			housekeeping = now;
 		}
 	}
 }
 
-void Server::processUsers()
+void Server::processShard(std::size_t index)
 {
-	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+	Shard& shard = *this->shards[index];
 
-	std::vector<std::shared_ptr<User>>::iterator iter;
-
-	for (iter = this->users.begin(); iter != this->users.end(); )
+	for (std::size_t i = 0; i < ShardBatch && shard.queue.pop(shard.delivery, std::chrono::milliseconds(0)); i++)
 	{
-		std::shared_ptr<User>& user = *iter;
+		Delivery& delivery = shard.delivery;
+
+		switch (delivery.type)
+		{
+		case Delivery::Attach:
+		{
+			shard.recipients.push_back(delivery.user);
 
-		if (user)
+			break;
+		}
+		case Delivery::Detach:
+		case Delivery::Release:
 		{
-			user->process();
+			std::vector<Connections::Handle>::iterator iter = std::find(shard.recipients.begin(), shard.recipients.end(), delivery.user);
 
-			while (user->hasMessage())
+			if (iter != shard.recipients.end())
 			{
-				this->writeMessage(user->getMessage());
+				*iter = shard.recipients.back();
+
+				shard.recipients.pop_back();
 			}
 
-			if (!user->isConnected())
+			if (delivery.type == Delivery::Release)
 			{
-				iter = this->users.erase(iter);
+				std::size_t slot = Connections::getIndex(delivery.user);
+
+				this->connections.at(slot).reset();
+
+				this->connections.hot(slot).scheduled = false;
+				this->connections.hot(slot).state = Connection::Free;
 
-				continue;
+				this->connections.release(delivery.user);
 			}
+
+			break;
 		}
+		case Delivery::Broadcast:
+		{
+			StringView head(delivery.line.data(), delivery.split);
+			StringView prefix = delivery.sender ? StringView(delivery.sender->prefix) : StringView();
+			StringView body(delivery.line.data() + delivery.split, delivery.line.length() - delivery.split);
 
-		iter++;
-	}
-}
+			for (Connections::Handle handle : shard.recipients)
+			{
+				if (handle != delivery.user)
+				{
+					this->connections.at(Connections::getIndex(handle)).sendLine({ head, prefix, body });
+				}
+			}
 
-void Server::processNetwork()
-{
-	while (this->run)
-	{
+			break;
+		}
+		case Delivery::Unicast:
+		{
+			StringView head(delivery.line.data(), delivery.split);
+			StringView prefix = delivery.sender ? StringView(delivery.sender->prefix) : StringView();
+			StringView body(delivery.line.data() + delivery.split, delivery.line.length() - delivery.split);
+
+			this->connections.at(Connections::getIndex(delivery.user)).sendLine({ head, prefix, body });
+
+			break;
+		}
+		case Delivery::Command:
+		{
+			this->connections.at(Connections::getIndex(delivery.user)).sendCmd(delivery.cmd, delivery.line);
+
+			break;
+		}
+		}
+
+		if (delivery.streamed > 0)
 		{
-			std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+			this->streamed -= delivery.streamed;
+		}
 
-			this->acceptUser();
+		delivery.sender.reset();
 
-			this->processUsers();
+		if (delivery.line.capacity() > LineCapacity)
+		{
+			std::string().swap(delivery.line);
 		}
+	}
+
+	shard.scheduled = false;
 
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	if (shard.queue.size() > 0)
+	{
+		this->scheduleShard(index);
 	}
 }
+
+const std::size_t Identities::SweepThreshold = 64;
+
+const std::string User::Empty;
+
+const double FloodLimits::Burst = 2.0;
+
+const std::chrono::milliseconds Peer::RetryDelay(1000);
+
+const std::size_t Server::AcceptBatch = 64;
+
+const std::chrono::seconds Server::SessionTimeout(30);
+
+const std::size_t Server::ReplayBytes = 1024 * 1024;
+
+const std::size_t Server::ReplayLines = 4096;
+
+const std::size_t Server::IngressCapacity = 4096;
+
+const std::size_t Server::EgressCapacity = 4096;
+
+const std::size_t Server::ShardBatch = 256;
+
+const std::size_t Server::TokenBytes = 16;
+
+const std::chrono::milliseconds Server::Tick(10);
+
+const std::size_t Server::ChunkSize = 16 * 1024;
+
+const std::size_t Server::ReceiveBatch = 16;
+
+const std::size_t Server::StreamBudget = 1024 * 1024;
+
+const std::size_t Server::LineCapacity = 4 * 1024;
+
+const std::chrono::seconds Server::TransferRetention(60);
+
+const unsigned long long Server::SpoolBudget = 4ull * 1024 * 1024 * 1024;
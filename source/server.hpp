@@ -19,15 +19,109 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdio>
+#include <cstdlib>
 
 #include "tcp-socket.hpp"
+#include "history.hpp"
+#include "metrics.hpp"
+#include "queue.hpp"
+#include "executor.hpp"
+#include "slab.hpp"
+#include "sanitizer.hpp"
+#include "token-bucket.hpp"
+#include "transfer.hpp"
+#include "capture.hpp"
+#include "handoff.hpp"
+
+#if defined(WINDOWS)
+
+#include <bcrypt.h>
+
+#endif
+
+struct Identity
+{
+	unsigned int id;
+
+	std::string name;
+	std::string prefix;
+};
+
+struct Message
+{
+public:
+	Message();
+	Message(const StringView& prefix, const StringView& body);
+	Message(const std::shared_ptr<const Identity>& sender, const StringView& body);
+
+	std::shared_ptr<const Identity> sender;
+
+	StringView prefix;
+	StringView body;
+};
+
+class Identities
+{
+public:
+	Identities();
+
+	std::shared_ptr<const Identity> intern(const std::string& name);
+
+private:
+	struct Entry
+	{
+		unsigned int id;
+
+		std::weak_ptr<const Identity> identity;
+	};
+
+	static const std::size_t SweepThreshold;
+
+	void sweep();
+
+	std::unordered_map<std::string, Entry> entries;
+
+	std::vector<unsigned int> released;
+
+	unsigned int next;
+
+	std::size_t threshold;
+};
+
+struct FloodLimits
+{
+	enum Action
+	{
+		Delay,
+		Drop,
+		Disconnect
+	};
+
+	FloodLimits();
+
+	double messages;
+	double bytes;
+
+	double roomMessages;
+	double roomBytes;
+
+	Action action;
+
+	static const double Burst;
+};
 
 class User
 {
 public:
-	User(std::shared_ptr<TcpSocket> tcpSocket);
+	User();
+
+	TcpSocket& getSocket();
 
 	bool isConnected() const;
 
@@ -35,46 +129,566 @@ public:
 
 	std::string getName();
 
+	const std::string& getPrefix() const;
+
+	const std::shared_ptr<const Identity>& getIdentity() const;
+
+	const std::string& getToken() const;
+
+	void setToken(const std::string& token);
+
+	std::size_t getShard() const;
+
+	void setShard(std::size_t shard);
+
+	bool isAttached() const;
+
+	void setAttached(bool attached);
+
+	bool hasJoined() const;
+
+	bool isResuming() const;
+
+	const std::string& getResumeToken() const;
+
+	unsigned long long getResumeSequence() const;
+
+	void resume(const std::shared_ptr<const Identity>& identity, const std::string& token);
+
+	void reject();
+
+	void replace();
+
+	bool isReplaced() const;
+
+	bool hasQuit() const;
+
+	bool hasTimedOut() const;
+
+	bool isPeering() const;
+
+	const std::string& getPeerOrigin() const;
+
+	const std::string& getPeerSecret() const;
+
 	bool hasMessage() const;
 
-	std::string getMessage();
+	Message getMessage();
 
-	void sendMessage(const std::string& message);
+	void sendLine(const StringView& line);
+
+	void sendLine(std::initializer_list<StringView> parts);
+
+	void sendCmd(char cmd, const StringView& argument = StringView());
+
+	void close();
+
+	void reset();
 
 	void process();
 
+	bool hasLine();
+
+	bool readLine(StringView& line, TcpSocket::Fragment& fragment);
+
+	void unreadLine();
+
+	void limit(const FloodLimits& limits);
+
+	TokenBucket& getMessageBucket();
+
+	TokenBucket& getByteBucket();
+
+	FloodLimits::Action getFloodAction() const;
+
+	bool isFlooding() const;
+
+	void setFlooding(bool flooding);
+
+	bool isStreaming() const;
+
+	const std::string& getStream() const;
+
+	void setStream(const std::string& stream);
+
+	bool isTransferring() const;
+
+	char getTransferCmd() const;
+
+	const std::string& getTransferArgument() const;
+
+	void setTransfer(const std::shared_ptr<Transfer>& transfer);
+
+	bool processTransfer();
+
+	void processLine(Identities& identities, const StringView& line);
+
+	void save(Handoff& handoff);
+
+	void restore(Handoff& handoff, Identities& identities);
+
 private:
-	void processMessage(const std::string& line);
+	struct Extras
+	{
+		Extras();
+
+		std::string resumeToken;
+		unsigned long long resumeSequence;
 
-	std::shared_ptr<TcpSocket> tcpSocket;
+		std::string peerOrigin;
+		std::string peerSecret;
+
+		std::string stream;
+
+		char transferCmd;
+		std::string transferArgument;
+
+		std::shared_ptr<Transfer> transfer;
+		unsigned long long transferOffset;
+	};
+
+	static const std::string Empty;
+
+	Extras& getExtras();
+
+	void processCmd(const StringView& line);
+
+	TcpSocket tcpSocket;
 
 	std::string name;
 
-	std::queue<std::string> messages;
+	std::shared_ptr<const Identity> identity;
+
+	std::string token;
+
+	std::size_t shard;
+
+	bool attached;
+	bool joined;
+	bool resuming;
+	bool replaced;
+	bool quit;
+	bool timedOut;
+	bool peering;
+	bool flooding;
+
+	TokenBucket messageBucket;
+	TokenBucket byteBucket;
+
+	FloodLimits::Action floodAction;
+
+	std::unique_ptr<Extras> extras;
+
+	std::vector<Message> messages;
+	std::size_t messageIndex;
+};
+
+struct Connection
+{
+	enum State
+	{
+		Free,
+		Reserved,
+		Open,
+		Closed,
+		Closing
+	};
+
+	enum Mode
+	{
+		Framed,
+		Pending,
+		Raw
+	};
+
+	std::atomic<unsigned char> state;
+	std::atomic<unsigned char> mode;
+
+	std::atomic_bool scheduled;
+	std::atomic_bool metered;
+
+	std::atomic<std::chrono::steady_clock::rep> deadline;
+};
+
+typedef Slab<User, Connection> Connections;
+
+class Peer
+{
+public:
+	Peer(const std::string& address);
+
+	Peer(Connections::Handle connection, const std::string& origin);
+
+	Connections::Handle getConnection() const;
+
+	void setConnection(Connections::Handle connection);
+
+	bool isOutgoing() const;
+
+	bool isConnected() const;
+
+	bool shouldConnect() const;
+
+	bool isConnecting() const;
+
+	void attempt();
+
+	void connect();
+
+	bool processConnect(Socket& socket);
+
+	void close();
+
+	const std::string& getAddress() const;
+
+	const std::string& getOrigin() const;
+
+	bool hasGreeted() const;
+
+	bool hasLinked() const;
+
+	bool isLinked() const;
+
+	unsigned long long getWanted() const;
+
+	bool hasMessage() const;
+
+	std::pair<unsigned long long, Message> getMessage();
+
+	void processLine(const StringView& line);
+
+private:
+	static const std::chrono::milliseconds RetryDelay;
+
+	Connections::Handle connection;
+
+	std::string address;
+	std::string origin;
+	std::string label;
+	std::string line;
+
+	bool outgoing;
+	bool greeted;
+	bool linked;
+	bool live;
+
+	unsigned long long wanted;
+
+	std::chrono::time_point<std::chrono::steady_clock> nextAttempt;
+
+	std::unique_ptr<Connector> connector;
+
+	std::vector<std::pair<unsigned long long, Message>> messages;
+	std::size_t messageIndex;
+
+	std::unordered_set<std::string> streams;
 };
 
 class Server
 {
 public:
-	Server(unsigned short port = Network::DefaultPort);
+	Server(unsigned short port = Network::DefaultPort, int backlog = Network::MaxConnections, const std::string& control = std::string());
 
 	~Server();
 
+	void addPeer(const std::string& address);
+
+	void setPeerSecret(const std::string& secret);
+
+	void setFloodLimits(const FloodLimits& limits);
+
+	void setCapture(const std::string& path);
+
+	void connectLocal(TcpSocket& tcpSocket);
+
+	void listenUnix(const std::string& path, int backlog = Network::MaxConnections);
+
 private:
-	void acceptUser();
+	struct Session
+	{
+		std::shared_ptr<const Identity> identity;
+
+		Connections::Handle user;
+
+		bool timedOut;
+
+		std::chrono::time_point<std::chrono::steady_clock> expiry;
+	};
+
+	struct Offer
+	{
+		std::shared_ptr<Transfer> transfer;
+
+		std::string session;
+
+		std::chrono::time_point<std::chrono::steady_clock> expiry;
+	};
+
+	struct Event
+	{
+		enum Type
+		{
+			Line,
+			Disconnected
+		};
+
+		Type type;
+
+		Connections::Handle user;
+
+		std::string line;
+
+		TcpSocket::Fragment fragment;
+
+		std::size_t streamed;
+
+		std::chrono::time_point<std::chrono::steady_clock> time;
+	};
+
+	struct Delivery
+	{
+		enum Type
+		{
+			Attach,
+			Detach,
+			Release,
+			Broadcast,
+			Unicast,
+			Command
+		};
+
+		Type type;
+
+		Connections::Handle user;
+
+		char cmd;
+
+		std::shared_ptr<const Identity> sender;
+
+		std::string line;
+
+		std::size_t split;
+
+		std::size_t streamed;
+	};
+
+	struct Shard
+	{
+		Shard(std::size_t capacity);
+
+		BoundedQueue<Delivery> queue;
+
+		std::atomic_bool scheduled;
+
+		std::size_t users;
+
+		std::vector<Connections::Handle> recipients;
+
+		Delivery delivery;
+	};
+
+	static const std::size_t AcceptBatch;
+
+	static const std::chrono::seconds SessionTimeout;
+
+	static const std::size_t ReplayBytes;
+
+	static const std::size_t ReplayLines;
+
+	static const std::size_t IngressCapacity;
+
+	static const std::size_t EgressCapacity;
+
+	static const std::size_t ShardBatch;
+
+	static const std::size_t TokenBytes;
+
+	static const std::chrono::milliseconds Tick;
+
+	static const std::size_t ChunkSize;
+
+	static const std::size_t ReceiveBatch;
+
+	static const std::size_t StreamBudget;
+
+	static const std::size_t LineCapacity;
+
+	static const std::chrono::seconds TransferRetention;
+
+	static const unsigned long long SpoolBudget;
+
+	bool takeOver(const std::string& control, int backlog);
+
+	void save(Handoff& handoff, std::vector<Connections::Handle>& handles);
+
+	void restore(Handoff& handoff, int backlog);
+
+	bool acceptUser();
+
+	bool acceptUser(User& user);
+
+	void wake();
+
+	bool admitLine(User& user, const StringView& line, const std::chrono::steady_clock::time_point& now, std::chrono::steady_clock::duration& wait);
+
+	bool pushEvent(Event& event, Event::Type type, Connections::Handle user, const StringView& line, TcpSocket::Fragment fragment, bool wait);
 
-	void writeMessage(const std::string& message);
+	void pushDelivery(std::size_t shard, Delivery::Type type, Connections::Handle user, char cmd, const StringView& line);
 
-	void processUsers();
+	void enqueueDelivery(std::size_t shard);
 
-	void processNetwork();
+	void scheduleShard(std::size_t shard);
+
+	void sendLine(Connections::Handle user, const StringView& line);
+
+	void sendCmd(Connections::Handle user, char cmd, const StringView& argument = StringView());
+
+	void deliverMessage(const Message& message);
+
+	void writeMessage(const Message& message);
+
+	void relayMessage(const std::shared_ptr<Peer>& peer, unsigned long long sequence, const Message& message);
+
+	std::string generateToken();
+
+	void attachUser(Connections::Handle handle);
+
+	void detachUser(Connections::Handle handle);
+
+	void createSession(Connections::Handle handle);
+
+	void resumeSession(Connections::Handle handle);
+
+	void closeSession(Connections::Handle handle);
+
+	void expireSessions();
+
+	void openTransfer(Connections::Handle handle);
+
+	void offerTransfer(const std::shared_ptr<Transfer>& transfer, Connections::Handle sender);
+
+	void expireOffers();
+
+	void captureEvent(const Event& event);
+
+	void flushCapture();
+
+	void processLine(Connections::Handle handle, const StringView& line, TcpSocket::Fragment fragment);
+
+	void processChunk(Connections::Handle handle, const StringView& line, bool more);
+
+	void processDisconnect(Connections::Handle handle);
+
+	void connectPeer(const std::shared_ptr<Peer>& peer);
+
+	void greetPeer(const std::shared_ptr<Peer>& peer);
+
+	void linkPeer(const std::shared_ptr<Peer>& peer);
+
+	void processPeerLine(const std::shared_ptr<Peer>& peer, const StringView& line);
+
+	void processPeers();
+
+	bool isTrustedPeer(const std::string& secret);
+
+	void processConnection(std::size_t index);
+
+	void processTransfer(std::size_t index);
+
+	void processEvent(Event& event);
+
+	void quiesce();
+
+	void processHandoff();
+
+	void processIngress();
+
+	void processRouting();
+
+	void processShard(std::size_t index);
 
 	TcpSocket tcpSocket;
 
-	std::vector<std::shared_ptr<User>> users;
+	std::unique_ptr<TcpSocket> unixSocket;
+
+	std::mutex listenMutex;
+	std::unique_ptr<TcpSocket> pendingListener;
+	std::string unixPath;
+
+	Handoff handoff;
+
+	std::atomic_bool holding;
+	std::atomic_bool held;
+
+	bool handedOff;
+
+	std::mutex wakeMutex;
+	std::condition_variable wakeCondition;
+	bool woken;
+
+	Connections connections;
+
+	Connections::Handle spare;
+
+	BoundedQueue<Event> events;
+
+	Event event;
+
+	std::vector<std::shared_ptr<Peer>> peers;
+
+	std::unordered_map<Connections::Handle, std::shared_ptr<Peer>> links;
+
+	Identities identities;
+
+	std::unordered_map<std::string, Session> sessions;
+
+	std::unordered_map<std::string, Offer> offers;
+
+	History replay;
+
+	unsigned long long sequence;
 
-	std::thread thread;
-	mutable std::recursive_mutex mutex;
+	std::string origin;
+
+	History relay;
+
+	unsigned long long relaySequence;
+
+	std::unordered_map<std::string, unsigned long long> origins;
+
+	std::size_t nextShard;
+
+	Delivery delivery;
+
+	std::string chunkPrefix;
+
+	std::size_t chunkBytes;
+
+	std::atomic<std::size_t> streamed;
+
+	std::vector<std::unique_ptr<Shard>> shards;
+
+	std::atomic_bool active;
+
+	std::thread ingress;
+	std::thread routing;
+
+	std::mutex peerMutex;
+	std::vector<std::string> pendingPeers;
+	std::string peerSecret;
+
+	std::mutex floodMutex;
+	FloodLimits floodLimits;
+	TokenBucket roomMessages;
+	TokenBucket roomBytes;
+	std::atomic_bool roomLimited;
+
+	std::unique_ptr<Capture> capture;
+
+	std::mutex captureMutex;
+	std::unique_ptr<Capture> pendingCapture;
 
 	std::atomic_bool run;
+
+	Executor executor;
 };
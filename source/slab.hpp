@@ -0,0 +1,208 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+template <typename T, typename H>
+class Slab
+{
+public:
+	typedef unsigned long long Handle;
+
+	Slab();
+
+	Handle allocate();
+
+	void release(Handle handle);
+
+	T* get(Handle handle);
+
+	T& at(std::size_t index);
+
+	H& hot(std::size_t index);
+
+	Handle getHandle(std::size_t index) const;
+
+	std::size_t getSlotCount() const;
+
+	std::size_t size() const;
+
+	static std::size_t getIndex(Handle handle);
+
+	static const Handle None = 0;
+
+	static const std::size_t ChunkSize = 256;
+
+	static const std::size_t MaxChunks = 4096;
+
+private:
+	struct Chunk
+	{
+		H hot[ChunkSize];
+
+		std::atomic<std::uint32_t> generations[ChunkSize];
+
+		T items[ChunkSize];
+	};
+
+	std::unique_ptr<Chunk> chunks[MaxChunks];
+
+	std::atomic<std::size_t> slotCount;
+	std::atomic<std::size_t> count;
+
+	std::vector<std::size_t> free;
+
+	std::mutex mutex;
+};
+
+template <typename T, typename H>
+Slab<T, H>::Slab() : slotCount(0), count(0)
+{
+
+}
+
+template <typename T, typename H>
+typename Slab<T, H>::Handle Slab<T, H>::allocate()
+{
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	std::size_t index = 0;
+
+	if (!this->free.empty())
+	{
+		index = this->free.back();
+
+		this->free.pop_back();
+	}
+	else
+	{
+		index = this->slotCount;
+
+		if (index / ChunkSize >= MaxChunks)
+		{
+			throw std::runtime_error("The connection table is full");
+		}
+
+		if (index % ChunkSize == 0)
+		{
+			this->chunks[index / ChunkSize] = std::unique_ptr<Chunk>(new Chunk());
+
+			for (std::size_t i = 0; i < ChunkSize; i++)
+			{
+				this->chunks[index / ChunkSize]->generations[i] = 1;
+			}
+		}
+
+		this->slotCount = index + 1;
+	}
+
+	this->count++;
+
+	return this->getHandle(index);
+}
+
+template <typename T, typename H>
+void Slab<T, H>::release(Handle handle)
+{
+	std::size_t index = getIndex(handle);
+
+	if (this->get(handle) == nullptr)
+	{
+		return;
+	}
+
+	this->chunks[index / ChunkSize]->generations[index % ChunkSize]++;
+
+	std::lock_guard<std::mutex> lockGuard(this->mutex);
+
+	this->free.push_back(index);
+
+	this->count--;
+}
+
+template <typename T, typename H>
+T* Slab<T, H>::get(Handle handle)
+{
+	std::size_t index = getIndex(handle);
+
+	if (handle == None || index >= this->slotCount)
+	{
+		return nullptr;
+	}
+
+	Chunk& chunk = *this->chunks[index / ChunkSize];
+
+	if (chunk.generations[index % ChunkSize] != static_cast<std::uint32_t>(handle >> 32))
+	{
+		return nullptr;
+	}
+
+	return &chunk.items[index % ChunkSize];
+}
+
+template <typename T, typename H>
+T& Slab<T, H>::at(std::size_t index)
+{
+	return this->chunks[index / ChunkSize]->items[index % ChunkSize];
+}
+
+template <typename T, typename H>
+H& Slab<T, H>::hot(std::size_t index)
+{
+	return this->chunks[index / ChunkSize]->hot[index % ChunkSize];
+}
+
+template <typename T, typename H>
+typename Slab<T, H>::Handle Slab<T, H>::getHandle(std::size_t index) const
+{
+	return (static_cast<Handle>(this->chunks[index / ChunkSize]->generations[index % ChunkSize]) << 32) | static_cast<Handle>(index);
+}
+
+template <typename T, typename H>
+std::size_t Slab<T, H>::getSlotCount() const
+{
+	return this->slotCount;
+}
+
+template <typename T, typename H>
+std::size_t Slab<T, H>::size() const
+{
+	return this->count;
+}
+
+template <typename T, typename H>
+std::size_t Slab<T, H>::getIndex(Handle handle)
+{
+	return static_cast<std::size_t>(handle & 0xFFFFFFFFull);
+}
+
+template <typename T, typename H>
+const typename Slab<T, H>::Handle Slab<T, H>::None;
+
+template <typename T, typename H>
+const std::size_t Slab<T, H>::ChunkSize;
+
+template <typename T, typename H>
+const std::size_t Slab<T, H>::MaxChunks;
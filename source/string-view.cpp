@@ -0,0 +1,48 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "string-view.hpp"
+
+StringView::StringView() : data(""), length(0)
+{
+
+}
+
+StringView::StringView(const char* data, std::size_t length) : data(data), length(length)
+{
+
+}
+
+StringView::StringView(const std::string& str) : data(str.data()), length(str.length())
+{
+
+}
+
+StringView::StringView(const char* str) : data(str), length(std::strlen(str))
+{
+
+}
+
+bool StringView::isEmpty() const
+{
+	return this->length == 0;
+}
+
+std::string StringView::str() const
+{
+	return std::string(this->data, this->length);
+}
@@ -16,13 +16,271 @@
  */
 
 #include "tcp-socket.hpp"
+#include "handoff.hpp"
+#include "metrics.hpp"
+#include "scanner.hpp"
 
-TcpSocket::TcpSocket() : socket(INVALID_SOCKET), bound(false), connected(false), pinged(false), lastTime(std::chrono::high_resolution_clock::now())
+#if defined(WINDOWS)
+
+#include <io.h>
+
+#elif defined(__linux__)
+
+#include <sys/sendfile.h>
+
+#endif
+
+Connector::Connector(const std::string& address) : started(0), failed(0), socket(INVALID_SOCKET)
 {
-	Network::startup();
+	if (Network::isUnixAddress(address))
+	{
+		std::string path = address.substr(Network::UnixPrefix.length());
+
+		this->endpoints.push_back(Network::getUnixEndpoint(path));
+
+		this->description = "the UNIX socket to " + path;
+	}
+	else
+	{
+		std::pair<std::string, unsigned short> splittedAddress = Network::splitAddress(address);
+
+		this->resolve(splittedAddress.first, splittedAddress.second);
+	}
+
+	this->start();
+}
+
+Connector::Connector(const std::string& host, unsigned short port) : started(0), failed(0), socket(INVALID_SOCKET)
+{
+	this->resolve(host, port);
+
+	this->start();
+}
+
+Connector::~Connector()
+{
+	for (Socket attempt : this->attempts)
+	{
+		if (attempt != INVALID_SOCKET)
+		{
+			::close(attempt);
+		}
+	}
+
+	if (this->socket != INVALID_SOCKET)
+	{
+		::close(this->socket);
+	}
+}
+
+bool Connector::process(std::chrono::milliseconds timeout)
+{
+	std::chrono::time_point<std::chrono::steady_clock> until = std::chrono::steady_clock::now() + timeout;
+
+	while (this->socket == INVALID_SOCKET && this->failed < this->endpoints.size())
+	{
+		std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+		if (now >= this->deadline)
+		{
+			break;
+		}
+
+		if (this->started < this->endpoints.size() && (now >= this->nextStart || this->started == this->failed))
+		{
+			const Endpoint& endpoint = this->endpoints[this->started];
+
+			Socket attempt = ::socket(endpoint.getFamily(), SOCK_STREAM, endpoint.getFamily() == AF_UNIX ? 0 : IPPROTO_TCP);
+
+			if (attempt != INVALID_SOCKET)
+			{
+				Network::setNonBlocking(attempt);
+
+				if (::connect(attempt, endpoint.getAddress(), endpoint.length) != SOCKET_ERROR)
+				{
+					this->socket = attempt;
+				}
+				else if (Network::isInProgress(Network::getLastError()))
+				{
+					this->attempts[this->started] = attempt;
+				}
+				else
+				{
+					::close(attempt);
+
+					this->failed++;
+				}
+			}
+			else
+			{
+				this->failed++;
+			}
+
+			this->started++;
+
+			this->nextStart = now + ConnectStagger;
+
+			continue;
+		}
+
+		std::chrono::time_point<std::chrono::steady_clock> wakeup = this->started < this->endpoints.size() ? std::min(this->nextStart, this->deadline) : this->deadline;
+
+		int wait = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(std::min(wakeup, until) - now).count());
+
+		wait = std::max(wait, 0);
+
+		std::vector<std::size_t> ready;
+
+		#if defined(WINDOWS)
+
+		fd_set writefds;
+		fd_set exceptfds;
+
+		FD_ZERO(&writefds);
+		FD_ZERO(&exceptfds);
+
+		for (Socket attempt : this->attempts)
+		{
+			if (attempt != INVALID_SOCKET)
+			{
+				FD_SET(attempt, &writefds);
+				FD_SET(attempt, &exceptfds);
+			}
+		}
+
+		timeval tv;
+		tv.tv_sec = wait / 1000;
+		tv.tv_usec = (wait % 1000) * 1000;
+
+		if (select(0, nullptr, &writefds, &exceptfds, &tv) > 0)
+		{
+			for (std::size_t i = 0; i < this->attempts.size(); i++)
+			{
+				if (this->attempts[i] != INVALID_SOCKET && (FD_ISSET(this->attempts[i], &writefds) || FD_ISSET(this->attempts[i], &exceptfds)))
+				{
+					ready.push_back(i);
+				}
+			}
+		}
+
+		#elif defined(POSIX)
+
+		std::vector<pollfd> fds;
+		std::vector<std::size_t> indices;
+
+		for (std::size_t i = 0; i < this->attempts.size(); i++)
+		{
+			if (this->attempts[i] != INVALID_SOCKET)
+			{
+				pollfd fd;
+
+				fd.fd = this->attempts[i];
+				fd.events = POLLOUT;
+				fd.revents = 0;
+
+				fds.push_back(fd);
+
+				indices.push_back(i);
+			}
+		}
+
+		if (poll(fds.data(), static_cast<nfds_t>(fds.size()), wait) > 0)
+		{
+			for (std::size_t i = 0; i < fds.size(); i++)
+			{
+				if (fds[i].revents != 0)
+				{
+					ready.push_back(indices[i]);
+				}
+			}
+		}
+
+		#endif
+
+		for (std::size_t i : ready)
+		{
+			int error = 0;
+			socklen_t length = sizeof(error);
+
+			if (getsockopt(this->attempts[i], SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &length) != SOCKET_ERROR && error == 0)
+			{
+				if (this->socket == INVALID_SOCKET)
+				{
+					this->socket = this->attempts[i];
+
+					this->attempts[i] = INVALID_SOCKET;
+				}
+			}
+			else
+			{
+				::close(this->attempts[i]);
+
+				this->attempts[i] = INVALID_SOCKET;
+
+				this->failed++;
+			}
+		}
+
+		if (this->socket == INVALID_SOCKET && this->failed < this->endpoints.size() && std::chrono::steady_clock::now() < this->deadline && std::chrono::steady_clock::now() >= until)
+		{
+			return false;
+		}
+	}
+
+	for (Socket& attempt : this->attempts)
+	{
+		if (attempt != INVALID_SOCKET)
+		{
+			::close(attempt);
+
+			attempt = INVALID_SOCKET;
+		}
+	}
+
+	return true;
+}
+
+bool Connector::isConnected() const
+{
+	return this->socket != INVALID_SOCKET;
+}
+
+Socket Connector::release()
+{
+	Socket socket = this->socket;
+
+	this->socket = INVALID_SOCKET;
+
+	return socket;
+}
+
+const std::string& Connector::getDescription() const
+{
+	return this->description;
+}
+
+void Connector::resolve(const std::string& host, unsigned short port)
+{
+	this->endpoints = Network::interleave(Network::resolve(host, port));
+
+	if (this->endpoints.size() == 0)
+	{
+		throw std::runtime_error("Failed to resolve " + host);
+	}
+
+	this->description = "the TCP socket to [" + host + "]:" + std::to_string(port);
 }
 
-TcpSocket::TcpSocket(Socket socket) : socket(socket), bound(false), connected(false), pinged(false)
+void Connector::start()
+{
+	this->attempts.assign(this->endpoints.size(), INVALID_SOCKET);
+
+	this->nextStart = std::chrono::steady_clock::now();
+
+	this->deadline = this->nextStart + ConnectTimeout;
+}
+
+TcpSocket::TcpSocket() : socket(INVALID_SOCKET), reserve(-1), pipe{ -1, -1 }, consumed(0), scanned(0), lineIndex(0), chunkSize(0), continued(false), partial(0), bound(false), connected(false), pinged(false), heartbeats(true), pingInterval(HeartbeatInterval), lastReceived(std::chrono::high_resolution_clock::now())
 {
 	Network::startup();
 }
@@ -66,324 +324,1233 @@ void TcpSocket::bind(unsigned short port)
 		addr.sin6_addr = in6addr_any;
 		addr.sin6_port = htons(port);
 
-		if (::bind(this->socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR)
-		{
-			this->close();
+		if (::bind(this->socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR)
+		{
+			this->close();
+
+			throw std::runtime_error("Failed to bind the TCP socket on port " + std::to_string(port));
+		}
+
+		this->bound = true;
+	}
+}
+
+void TcpSocket::bind(const std::string& path)
+{
+	#if defined(POSIX)
+
+	sockaddr_un addr;
+
+	if (path.empty() || path.length() >= sizeof(addr.sun_path))
+	{
+		throw std::runtime_error("Invalid UNIX socket path " + path);
+	}
+
+	std::memset(&addr, 0, sizeof(addr));
+
+	addr.sun_family = AF_UNIX;
+
+	std::memcpy(addr.sun_path, path.data(), path.length());
+
+	struct stat status;
+
+	if (stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode))
+	{
+		Socket probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+		bool live = probe != INVALID_SOCKET && ::connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != SOCKET_ERROR;
+
+		if (probe != INVALID_SOCKET)
+		{
+			::close(probe);
+		}
+
+		if (live)
+		{
+			throw std::runtime_error("The UNIX socket " + path + " is already in use");
+		}
+
+		unlink(path.c_str());
+	}
+
+	this->setup(AF_UNIX, 0);
+
+	if (::bind(this->socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR)
+	{
+		this->close();
+
+		throw std::runtime_error("Failed to bind the UNIX socket on " + path);
+	}
+
+	this->path = path;
+
+	this->bound = true;
+
+	#else
+
+	throw std::runtime_error("UNIX domain sockets are not supported on this platform");
+
+	#endif
+}
+
+bool TcpSocket::isBound() const
+{
+	return this->bound;
+}
+
+const std::string& TcpSocket::getPath() const
+{
+	return this->path;
+}
+
+void TcpSocket::listen(int maxConnections)
+{
+	if (!this->bound)
+	{
+		throw std::runtime_error("The TCP socket is not bound");
+	}
+
+	if (this->socket != INVALID_SOCKET)
+	{
+		if (::listen(this->socket, maxConnections) == SOCKET_ERROR)
+		{
+			this->close();
+
+			throw std::runtime_error("Failed to place the TCP socket in listening state");
+		}
+
+		Network::setNonBlocking(this->socket);
+
+		#if defined(POSIX)
+
+		this->reserve = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+		#endif
+	}
+}
+
+void TcpSocket::connect(const std::string& address, unsigned short port)
+{
+	Connector connector(address, port);
+
+	connector.process(Connector::ConnectTimeout);
+
+	if (!connector.isConnected())
+	{
+		throw std::runtime_error("Failed to connect " + connector.getDescription());
+	}
+
+	Socket socket = connector.release();
+
+	this->close();
+
+	Network::setNonBlocking(socket, false);
+
+	this->socket = socket;
+
+	this->setup();
+
+	this->connected = true;
+}
+
+void TcpSocket::connect(const std::string& address)
+{
+	if (Network::isUnixAddress(address))
+	{
+		this->connectUnix(address.substr(Network::UnixPrefix.length()));
+
+		return;
+	}
+
+	std::pair<std::string, unsigned short> splittedAddress = Network::splitAddress(address);
+
+	this->connect(splittedAddress.first, splittedAddress.second);
+}
+
+void TcpSocket::connectUnix(const std::string& path)
+{
+	#if defined(POSIX)
+
+	Endpoint endpoint = Network::getUnixEndpoint(path);
+
+	Socket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (socket == INVALID_SOCKET)
+	{
+		throw std::runtime_error("Failed to initialize the UNIX socket");
+	}
+
+	if (::connect(socket, endpoint.getAddress(), endpoint.length) == SOCKET_ERROR)
+	{
+		::close(socket);
+
+		throw std::runtime_error("Failed to connect the UNIX socket to " + path);
+	}
+
+	this->close();
+
+	this->socket = socket;
+
+	this->setup();
+
+	this->connected = true;
+
+	#else
+
+	throw std::runtime_error("UNIX domain sockets are not supported on this platform");
+
+	#endif
+}
+
+void TcpSocket::pair(TcpSocket& tcpSocket, const Channel::Notifier& notifier)
+{
+	std::shared_ptr<Channel> forward(new Channel());
+	std::shared_ptr<Channel> backward(new Channel());
+
+	forward->setNotifier(notifier);
+
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+		this->close();
+
+		this->inbound = forward;
+		this->outbound = backward;
+
+		this->pinged = false;
+		this->heartbeats = false;
+
+		this->connected = true;
+	}
+
+	{
+		std::lock_guard<std::recursive_mutex> lockGuard(tcpSocket.mutex);
+
+		tcpSocket.close();
+
+		tcpSocket.inbound = backward;
+		tcpSocket.outbound = forward;
+
+		tcpSocket.pinged = false;
+		tcpSocket.heartbeats = false;
+
+		tcpSocket.connected = true;
+	}
+}
+
+bool TcpSocket::isConnected() const
+{
+	return this->connected;
+}
+
+bool TcpSocket::isPaired() const
+{
+	return this->inbound != nullptr;
+}
+
+bool TcpSocket::hasTimedOut() const
+{
+	if (this->isConnected() && this->pinged)
+	{
+		if (std::chrono::high_resolution_clock::now() - this->pingTime >= HeartbeatTimeout)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool TcpSocket::isAvailable() const
+{
+	return this->wait(std::chrono::milliseconds(0));
+}
+
+bool TcpSocket::wait(std::chrono::milliseconds timeout, bool writable) const
+{
+	if (this->inbound)
+	{
+		return writable || this->inbound->wait(timeout);
+	}
+
+	if (this->socket != INVALID_SOCKET)
+	{
+		#if defined(WINDOWS)
+
+		fd_set fds;
+
+		timeval tv;
+		tv.tv_sec = static_cast<long>(timeout.count() / 1000);
+		tv.tv_usec = static_cast<long>((timeout.count() % 1000) * 1000);
+
+		FD_ZERO(&fds);
+		FD_SET(this->socket, &fds);
+
+		if (select(static_cast<int>(this->socket) + 1, writable ? nullptr : &fds, writable ? &fds : nullptr, nullptr, &tv) > 0)
+		{
+			if (FD_ISSET(this->socket, &fds) > 0)
+			{
+				return true;
+			}
+		}
+
+		#elif defined(POSIX)
+
+		pollfd fd;
+
+		fd.fd = this->socket;
+		fd.events = writable ? POLLOUT : POLLIN;
+		fd.revents = 0;
+
+		if (poll(&fd, 1, static_cast<int>(timeout.count())) > 0)
+		{
+			return (fd.revents & (fd.events | POLLHUP | POLLERR)) != 0;
+		}
+
+		#endif
+	}
+
+	return false;
+}
+
+std::shared_ptr<TcpSocket> TcpSocket::accept()
+{
+	std::shared_ptr<TcpSocket> tcpSocket(new TcpSocket());
+
+	if (!this->accept(*tcpSocket))
+	{
+		tcpSocket.reset();
+	}
+
+	return tcpSocket;
+}
+
+bool TcpSocket::accept(TcpSocket& tcpSocket)
+{
+	if (this->socket == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	#if defined(SOCK_NONBLOCK)
+
+	Socket socket = ::accept4(this->socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+	#else
+
+	Socket socket = ::accept(this->socket, nullptr, nullptr);
+
+	if (socket != INVALID_SOCKET)
+	{
+		Network::setNonBlocking(socket);
+	}
+
+	#endif
+
+	if (socket == INVALID_SOCKET)
+	{
+		int error = Network::getLastError();
+
+		if (!Network::isWouldBlock(error))
+		{
+			Metrics::count(Metrics::AcceptFailures);
+
+			Metrics::countError("accept", error);
+
+			#if defined(POSIX)
+
+			if (error == EMFILE || error == ENFILE)
+			{
+				this->shed();
+			}
+
+			#endif
+		}
+
+		return false;
+	}
+
+	tcpSocket.attach(socket);
+
+	Metrics::count(Metrics::AcceptedConnections);
+
+	return true;
+}
+
+bool TcpSocket::hasLine()
+{
+	return this->lineIndex < this->lines.size();
+}
+
+std::string TcpSocket::readLine()
+{
+	StringView line;
+
+	if (this->readLine(line))
+	{
+		return line.str();
+	}
+
+	return "";
+}
+
+bool TcpSocket::readLine(StringView& line)
+{
+	if (this->lineIndex < this->lines.size())
+	{
+		line = StringView(this->input.data() + this->lines[this->lineIndex].offset, this->lines[this->lineIndex].length);
+
+		this->lineIndex++;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool TcpSocket::readLine(StringView& line, Fragment& fragment)
+{
+	if (this->lineIndex < this->lines.size())
+	{
+		fragment = this->lines[this->lineIndex].fragment;
+	}
+
+	return this->readLine(line);
+}
+
+void TcpSocket::unreadLine()
+{
+	if (this->lineIndex > 0)
+	{
+		this->lineIndex--;
+	}
+}
+
+void TcpSocket::writeLine(const StringView& line)
+{
+	this->writeLine({ line });
+}
+
+void TcpSocket::writeLine(std::initializer_list<StringView> parts)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (this->socket == INVALID_SOCKET && !this->outbound)
+	{
+		return;
+	}
+
+	if (parts.size() == 0 || parts.begin()->isEmpty() || parts.begin()->data[0] != '\b')
+	{
+		Metrics::count(Metrics::LinesSent);
+	}
+
+	if (this->outbound)
+	{
+		if (!this->outbound->writeLine(parts))
+		{
+			this->close();
+		}
+		else if (this->outbound->getSize() > SendLimit)
+		{
+			Metrics::count(Metrics::SendOverflows);
+
+			this->close();
+		}
+
+		return;
+	}
+
+	if (parts.size() >= MaxParts || this->output.length() > 0 || this->control.length() > 0)
+	{
+		for (const StringView& part : parts)
+		{
+			this->output.append(part.data, part.length);
+		}
+
+		this->output += '\n';
+
+		this->flush();
+
+		if (this->output.length() > SendLimit)
+		{
+			Metrics::count(Metrics::SendOverflows);
+
+			this->close();
+		}
+
+		return;
+	}
+
+	std::size_t count = 0;
+	std::size_t total = 0;
+
+	#if defined(WINDOWS)
+
+	WSABUF buffers[MaxParts];
+
+	for (const StringView& part : parts)
+	{
+		buffers[count].buf = const_cast<char*>(part.data);
+		buffers[count].len = static_cast<ULONG>(part.length);
+
+		total += part.length;
+
+		count++;
+	}
+
+	buffers[count].buf = const_cast<char*>("\n");
+	buffers[count].len = 1;
+
+	total++;
+
+	count++;
+
+	DWORD sent = 0;
+
+	if (WSASend(this->socket, buffers, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+	{
+		if (!Network::isWouldBlock(Network::getLastError()))
+		{
+			this->close();
+
+			return;
+		}
+
+		sent = 0;
+	}
+
+	std::size_t written = static_cast<std::size_t>(sent);
+
+	#elif defined(POSIX)
+
+	iovec buffers[MaxParts];
+
+	for (const StringView& part : parts)
+	{
+		buffers[count].iov_base = const_cast<char*>(part.data);
+		buffers[count].iov_len = part.length;
+
+		total += part.length;
+
+		count++;
+	}
+
+	buffers[count].iov_base = const_cast<char*>("\n");
+	buffers[count].iov_len = 1;
+
+	total++;
+
+	count++;
+
+	msghdr message;
+
+	std::memset(&message, 0, sizeof(message));
+
+	message.msg_iov = buffers;
+	message.msg_iovlen = count;
+
+	ssize_t sent = sendmsg(this->socket, &message, MSG_NOSIGNAL);
+
+	if (sent < 0 && Network::isWouldBlock(Network::getLastError()))
+	{
+		sent = 0;
+	}
+	else if (sent <= 0)
+	{
+		this->close();
+
+		return;
+	}
+
+	std::size_t written = static_cast<std::size_t>(sent);
+
+	#endif
+
+	if (written < total)
+	{
+		this->partial = total - written;
+
+		for (const StringView& part : parts)
+		{
+			if (written < part.length)
+			{
+				this->output.append(part.data + written, part.length - written);
+			}
+
+			written -= std::min(written, part.length);
+		}
+
+		this->output += '\n';
+
+		this->flush();
+	}
+}
+
+std::size_t TcpSocket::sendFile(std::FILE* file, unsigned long long offset, std::size_t length)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (this->output.length() > 0 || this->control.length() > 0)
+	{
+		this->flush();
+	}
+
+	if (this->socket == INVALID_SOCKET || this->output.length() > 0 || this->control.length() > 0 || length == 0)
+	{
+		return 0;
+	}
+
+	#if defined(__linux__)
+
+	off_t position = static_cast<off_t>(offset);
+
+	ssize_t sent = sendfile(this->socket, fileno(file), &position, length);
+
+	#else
+
+	char buffer[16 * 1024];
+
+	length = std::min(length, sizeof(buffer));
+
+	#if defined(WINDOWS)
+
+	OVERLAPPED overlapped;
+
+	std::memset(&overlapped, 0, sizeof(overlapped));
+
+	overlapped.Offset = static_cast<DWORD>(offset);
+	overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+	DWORD count = 0;
+
+	if (!ReadFile(reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file))), buffer, static_cast<DWORD>(length), &count, &overlapped))
+	{
+		count = 0;
+	}
+
+	#elif defined(POSIX)
+
+	ssize_t count = pread(fileno(file), buffer, length, static_cast<off_t>(offset));
+
+	#endif
+
+	int sent = count > 0 ? send(this->socket, buffer, static_cast<int>(count), MSG_NOSIGNAL) : 0;
+
+	#endif
+
+	if (sent < 0 && Network::isWouldBlock(Network::getLastError()))
+	{
+		return 0;
+	}
+
+	if (sent <= 0)
+	{
+		this->close();
+
+		return 0;
+	}
+
+	return static_cast<std::size_t>(sent);
+}
+
+std::size_t TcpSocket::receiveFile(std::FILE* file, std::size_t length)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (this->output.length() > 0 || this->control.length() > 0)
+	{
+		this->flush();
+	}
+
+	if (this->socket == INVALID_SOCKET || length == 0)
+	{
+		return 0;
+	}
+
+	if (this->consumed < this->input.length())
+	{
+		std::size_t buffered = std::min(length, this->input.length() - this->consumed);
+
+		if (std::fwrite(this->input.data() + this->consumed, 1, buffered, file) != buffered || std::fflush(file) != 0)
+		{
+			this->close();
+
+			return 0;
+		}
+
+		this->consumed += buffered;
+		this->scanned = std::max(this->scanned, this->consumed);
+
+		return buffered;
+	}
+
+	#if defined(__linux__)
+
+	if (this->pipe[0] == -1 && pipe2(this->pipe, O_CLOEXEC | O_NONBLOCK) != 0)
+	{
+		this->close();
+
+		return 0;
+	}
+
+	ssize_t received = splice(this->socket, nullptr, this->pipe[1], nullptr, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+	for (ssize_t written = 0; received > 0 && written < received; )
+	{
+		ssize_t result = splice(this->pipe[0], nullptr, fileno(file), nullptr, static_cast<std::size_t>(received - written), SPLICE_F_MOVE);
+
+		if (result <= 0)
+		{
+			this->close();
+
+			return static_cast<std::size_t>(written);
+		}
+
+		written += result;
+	}
+
+	#else
+
+	char buffer[16 * 1024];
+
+	int received = recv(this->socket, buffer, static_cast<int>(std::min(length, sizeof(buffer))), 0);
+
+	if (received > 0 && std::fwrite(buffer, 1, static_cast<std::size_t>(received), file) != static_cast<std::size_t>(received))
+	{
+		this->close();
+
+		return 0;
+	}
+
+	#endif
+
+	if (received < 0 && Network::isWouldBlock(Network::getLastError()))
+	{
+		return 0;
+	}
+
+	if (received <= 0)
+	{
+		this->close();
+
+		return 0;
+	}
+
+	this->lastReceived = std::chrono::high_resolution_clock::now();
+
+	return static_cast<std::size_t>(received);
+}
+
+void TcpSocket::setNonBlocking(bool enable)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	Network::setNonBlocking(this->socket, enable);
+}
+
+void TcpSocket::setStreaming(std::size_t chunkSize)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	this->chunkSize = chunkSize;
+}
+
+void TcpSocket::close()
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	if (this->socket != INVALID_SOCKET)
+	{
+		::close(this->socket);
+
+		this->socket = INVALID_SOCKET;
+	}
+
+	#if defined(POSIX)
+
+	if (this->reserve != -1)
+	{
+		::close(this->reserve);
+
+		this->reserve = -1;
+	}
+
+	if (this->pipe[0] != -1)
+	{
+		::close(this->pipe[0]);
+		::close(this->pipe[1]);
+
+		this->pipe[0] = -1;
+		this->pipe[1] = -1;
+	}
+
+	if (!this->path.empty())
+	{
+		unlink(this->path.c_str());
+
+		this->path.clear();
+	}
+
+	#endif
+
+	if (this->inbound)
+	{
+		this->inbound->close();
+		this->outbound->close();
+
+		this->inbound.reset();
+		this->outbound.reset();
+	}
+
+	this->output.clear();
+
+	this->control.clear();
+
+	this->partial = 0;
+
+	this->bound = false;
+
+	this->connected = false;
+}
+
+Socket TcpSocket::release()
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	Socket socket = this->socket;
+
+	this->socket = INVALID_SOCKET;
+
+	this->path.clear();
+
+	this->close();
+
+	return socket;
+}
+
+void TcpSocket::attach(Socket socket)
+{
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	this->close();
+
+	this->input.clear();
+
+	this->consumed = 0;
+	this->scanned = 0;
+
+	this->lines.clear();
+
+	this->lineIndex = 0;
 
-			throw std::runtime_error("Failed to bind the TCP socket on port " + std::to_string(port));
-		}
+	this->continued = false;
 
-		this->bound = true;
-	}
+	this->socket = socket;
+
+	this->setup();
+
+	this->connected = true;
 }
 
-bool TcpSocket::isBound() const
+void TcpSocket::detach()
 {
-	return this->bound;
+	Socket socket = this->release();
+
+	if (socket != INVALID_SOCKET)
+	{
+		::close(socket);
+	}
 }
 
-void TcpSocket::listen(int maxConnections)
+void TcpSocket::save(Handoff& handoff) const
 {
-	if (!this->bound)
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	std::size_t begin = this->lineIndex < this->lines.size() ? this->lines[this->lineIndex].offset : this->consumed;
+
+	handoff.writeSocket(this->socket);
+
+	handoff.writeString(StringView(this->input.data() + begin, this->input.length() - begin));
+
+	handoff.writeNumber(this->consumed - begin);
+	handoff.writeNumber(this->scanned - begin);
+
+	handoff.writeNumber(this->lines.size() - this->lineIndex);
+
+	for (std::size_t i = this->lineIndex; i < this->lines.size(); i++)
 	{
-		throw std::runtime_error("The TCP socket is not bound");
+		handoff.writeNumber(this->lines[i].offset - begin);
+		handoff.writeNumber(this->lines[i].length);
+		handoff.writeNumber(this->lines[i].fragment);
 	}
 
-	if (this->socket != INVALID_SOCKET)
-	{
-		if (::listen(this->socket, maxConnections) == SOCKET_ERROR)
-		{
-			this->close();
+	handoff.writeNumber(this->chunkSize);
+	handoff.writeNumber(this->continued ? 1 : 0);
 
-			throw std::runtime_error("Failed to place the TCP socket in listening state");
-		}
-	}
+	handoff.writeString(this->output);
+	handoff.writeString(this->control);
+
+	handoff.writeNumber(this->partial);
+
+	handoff.writeNumber(static_cast<unsigned long long>(this->pingInterval.count()));
+
+	handoff.writeNumber(this->bound ? 1 : 0);
+
+	handoff.writeString(this->path);
 }
 
-void TcpSocket::connect(const std::string& address, unsigned short port)
+void TcpSocket::restore(Handoff& handoff)
 {
-	sockaddr* addr = nullptr;
-	socklen_t addrLen = 0;
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
-	int family = 0;
+	this->close();
+
+	this->socket = handoff.readSocket();
 
-	std::string ipAddress = Network::resolveHostIPv6(address);
+	this->input = handoff.readString();
 
-	if (ipAddress != "")
+	this->consumed = static_cast<std::size_t>(handoff.readNumber());
+	this->scanned = static_cast<std::size_t>(handoff.readNumber());
+
+	if (this->consumed > this->scanned || this->scanned > this->input.length())
 	{
-		sockaddr_in6 addr6;
+		throw std::runtime_error("Malformed handoff state");
+	}
 
-		std::memset(&addr6, 0, sizeof(addr6));
+	unsigned long long count = handoff.readNumber();
 
-		addr6.sin6_family = AF_INET6;
-		addr6.sin6_port = htons(port);
+	this->lines.clear();
 
-		if (inet_pton(AF_INET6, ipAddress.c_str(), &(addr6.sin6_addr)))
-		{
-			addr = reinterpret_cast<sockaddr*>(&addr6);
+	this->lineIndex = 0;
+
+	for (unsigned long long i = 0; i < count; i++)
+	{
+		Line line;
 
-			addrLen = sizeof(addr6);
+		line.offset = static_cast<std::size_t>(handoff.readNumber());
+		line.length = static_cast<std::size_t>(handoff.readNumber());
+		line.fragment = static_cast<Fragment>(handoff.readNumber());
 
-			family = AF_INET6;
-		}
-		else
+		if (line.offset > this->consumed || line.length > this->consumed - line.offset || line.fragment > Tail)
 		{
-			throw std::runtime_error("Not a valid IP address");
+			throw std::runtime_error("Malformed handoff state");
 		}
+
+		this->lines.push_back(line);
 	}
-	else
-	{
-		ipAddress = Network::resolveHostIPv4(address);
 
-		if (ipAddress != "")
-		{
-			sockaddr_in addr4;
+	this->chunkSize = static_cast<std::size_t>(handoff.readNumber());
+	this->continued = handoff.readNumber() != 0;
 
-			std::memset(&addr4, 0, sizeof(addr4));
+	this->output = handoff.readString();
+	this->control = handoff.readString();
 
-			addr4.sin_family = AF_INET;
-			addr4.sin_port = htons(port);
+	this->partial = static_cast<std::size_t>(handoff.readNumber());
 
-			if (inet_pton(AF_INET, ipAddress.c_str(), &(addr4.sin_addr)))
-			{
-				addr = reinterpret_cast<sockaddr*>(&addr4);
+	if (this->partial > this->output.length())
+	{
+		throw std::runtime_error("Malformed handoff state");
+	}
 
-				addrLen = sizeof(addr4);
+	std::chrono::milliseconds pingInterval(static_cast<std::chrono::milliseconds::rep>(handoff.readNumber()));
 
-				family = AF_INET;
-			}
-			else
-			{
-				throw std::runtime_error("Not a valid IP address");
-			}
-		}
-		else
-		{
-			throw std::runtime_error("Failed to resolve " + address);
-		}
-	}
+	bool bound = handoff.readNumber() != 0;
 
-	this->setup(family);
+	std::string path = handoff.readString();
 
-	if (this->socket != INVALID_SOCKET)
+	this->path = path;
+
+	this->bound = bound;
+
+	if (!this->bound)
 	{
-		if (::connect(this->socket, addr, addrLen) == SOCKET_ERROR)
-		{
-			this->close();
+		this->setup();
 
-			throw std::runtime_error("Failed to connect the TCP socket to [" + address + "]:" + std::to_string(port));
-		}
+		this->pingInterval = pingInterval;
 
 		this->connected = true;
 	}
 }
 
-void TcpSocket::connect(const std::string& address)
-{
-	std::pair<std::string, unsigned short> splittedAddress = Network::splitAddress(address);
-
-	this->connect(splittedAddress.first, splittedAddress.second);
-}
-
-bool TcpSocket::isConnected() const
+void TcpSocket::process()
 {
-	return this->connected;
-}
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
-bool TcpSocket::hasTimedOut() const
-{
-	if (this->isConnected() && this->pinged)
+	if (this->socket != INVALID_SOCKET || this->inbound)
 	{
-		std::chrono::time_point<std::chrono::high_resolution_clock> currentTime = std::chrono::high_resolution_clock::now();
+		this->compact();
 
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - this->lastTime).count();
+		if (this->output.length() > 0 || this->control.length() > 0)
+		{
+			this->flush();
+		}
 
-		if (time >= 10.0f)
+		if (this->inbound && this->input.length() < ReceiveLimit)
 		{
-			return true;
+			bool closed = this->inbound->isClosed();
+
+			if (this->inbound->read(this->input, ReceiveLimit - this->input.length()) > 0)
+			{
+				this->lastReceived = std::chrono::high_resolution_clock::now();
+			}
+			else if (closed)
+			{
+				this->close();
+			}
 		}
-	}
 
-	return false;
-}
+		while (this->socket != INVALID_SOCKET && this->input.length() < ReceiveLimit && this->isAvailable())
+		{
+			std::size_t length = this->input.length();
 
-bool TcpSocket::isAvailable() const
-{
-	if (this->socket != INVALID_SOCKET)
-	{
-		fd_set readfds;
+			std::size_t size = std::min(ReceiveSize, ReceiveLimit - length);
 
-		timeval tv;
-		tv.tv_sec = 0;
-		tv.tv_usec = 0;
+			this->input.resize(length + size);
 
-		FD_ZERO(&readfds);
-		FD_SET(this->socket, &readfds);
+			int received = recv(this->socket, &(this->input[length]), static_cast<int>(size), 0);
 
-		if (select(static_cast<int>(this->socket) + 1, &readfds, nullptr, nullptr, &tv) > 0)
-		{
-			if (FD_ISSET(this->socket, &readfds) > 0)
+			this->input.resize(length + std::max(received, 0));
+
+			if (received <= 0)
 			{
-				return true;
+				this->close();
+
+				break;
 			}
+
+			this->lastReceived = std::chrono::high_resolution_clock::now();
+
+			this->pinged = false;
 		}
-	}
 
-	return false;
-}
+		this->newlines.clear();
 
-std::shared_ptr<TcpSocket> TcpSocket::accept()
-{
-	std::shared_ptr<TcpSocket> tcpSocket;
+		Scanner::scan(this->input.data(), this->scanned, this->input.length(), this->newlines);
 
-	if (this->socket != INVALID_SOCKET)
-	{
-		Socket socket = ::accept(this->socket, nullptr, nullptr);
+		this->scanned = this->input.length();
 
-		if (socket != INVALID_SOCKET)
+		for (std::size_t position : this->newlines)
 		{
-			tcpSocket = std::shared_ptr<TcpSocket>(new TcpSocket(socket));
+			std::size_t offset = this->consumed;
+
+			this->consumed = position + 1;
 
-			if (tcpSocket)
+			if (this->continued)
 			{
-				tcpSocket->connected = true;
+				this->processLine(offset, position - offset, Tail);
+
+				this->continued = false;
+			}
+			else if (!this->processCmd(StringView(this->input.data() + offset, position - offset)))
+			{
+				this->processLine(offset, position - offset, Whole);
 			}
 		}
-		else
+
+		this->processChunks();
+
+		if (this->isConnected() && !this->pinged && this->heartbeats)
 		{
-			this->close();
+			std::chrono::time_point<std::chrono::high_resolution_clock> currentTime = std::chrono::high_resolution_clock::now();
+
+			std::chrono::high_resolution_clock::duration idle = currentTime - this->lastReceived;
+
+			if (idle >= this->pingInterval && !(keepAlive && this->pingInterval >= HeartbeatMaximumInterval))
+			{
+				this->writeCmd('p');
+
+				Metrics::count(Metrics::HeartbeatsSent);
+
+				this->pingTime = currentTime;
+
+				this->pinged = true;
+			}
 		}
 	}
-
-	return tcpSocket;
 }
 
-bool TcpSocket::hasLine()
+void TcpSocket::setKeepAlive(bool enable)
 {
-	return this->lines.size() > 0;
+	keepAlive = enable;
 }
 
-std::string TcpSocket::readLine()
+void TcpSocket::setup()
 {
-	std::string str;
+	this->pinged = false;
+
+	this->pingInterval = HeartbeatInterval;
+
+	this->lastReceived = std::chrono::high_resolution_clock::now();
+
+	sockaddr_storage address;
+	socklen_t length = sizeof(address);
 
-	if (this->lines.size() > 0)
+	this->heartbeats = getsockname(this->socket, reinterpret_cast<sockaddr*>(&address), &length) == SOCKET_ERROR || address.ss_family != AF_UNIX;
+
+	if (!this->heartbeats)
 	{
-		str = this->lines.front();
+		int size = static_cast<int>(UnixBuffer);
 
-		this->lines.pop();
+		setsockopt(this->socket, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<char*>(&size), sizeof(size));
 	}
 
-	return str;
+	if (keepAlive && this->heartbeats)
+	{
+		int flag = 1;
+
+		setsockopt(this->socket, SOL_SOCKET, SO_KEEPALIVE, reinterpret_cast<char*>(&flag), sizeof(flag));
+
+		#if defined(TCP_KEEPIDLE) && defined(TCP_KEEPINTVL) && defined(TCP_KEEPCNT)
+
+		int idle = static_cast<int>(std::chrono::duration_cast<std::chrono::seconds>(KeepAliveIdle).count());
+		int interval = 10;
+		int count = 6;
+
+		setsockopt(this->socket, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+		setsockopt(this->socket, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+		setsockopt(this->socket, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+
+		#endif
+	}
 }
 
-void TcpSocket::writeLine(const std::string& line)
+void TcpSocket::setup(int family, int protocol)
 {
-	if (this->socket != INVALID_SOCKET)
-	{
-		std::string str = line + "\n";
+	this->close();
 
-		if (send(this->socket, str.c_str(), static_cast<int>(str.length()), 0) <= 0)
-		{
-			this->close();
-		}
+	this->socket = ::socket(family, SOCK_STREAM, protocol);
+
+	if (this->socket == INVALID_SOCKET)
+	{
+		throw std::runtime_error("Failed to initialize the TCP socket");
 	}
 }
 
-void TcpSocket::close()
+void TcpSocket::writeCmd(char cmd, const StringView& argument)
 {
-	if (this->socket != INVALID_SOCKET)
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
+
+	char str[2] = { '\b', cmd };
+
+	if (this->output.length() > 0 || this->control.length() > 0)
 	{
-		::close(this->socket);
+		this->control.append(str, 2);
+		this->control.append(argument.data, argument.length);
 
-		this->socket = INVALID_SOCKET;
-	}
+		this->control += '\n';
 
-	this->pinged = false;
+		this->flush();
 
-	this->bound = false;
+		return;
+	}
 
-	this->connected = false;
+	this->writeLine({ StringView(str, 2), argument });
 }
 
-void TcpSocket::process()
+void TcpSocket::flush()
 {
-	if (this->socket != INVALID_SOCKET)
-	{
-		while (this->isAvailable())
-		{
-			std::array<char, 1024> bytes;
+	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
-			bytes.fill('\0');
+	while (this->socket != INVALID_SOCKET)
+	{
+		bool bulk = this->partial > 0 || this->control.length() == 0;
 
-			if (recv(this->socket, bytes.data(), static_cast<int>(bytes.size()) - 1, 0) <= 0)
-			{
-				this->close();
+		std::string& queue = bulk ? this->output : this->control;
 
-				break;
-			}
+		std::size_t length = this->partial > 0 ? this->partial : queue.length();
 
-			this->input += bytes.data();
+		if (length == 0)
+		{
+			break;
 		}
 
-		std::size_t position = this->input.find("\n");
+		int result = send(this->socket, queue.data(), static_cast<int>(length), MSG_NOSIGNAL);
 
-		if (position != std::string::npos)
+		if (result < 0 && Network::isWouldBlock(Network::getLastError()))
 		{
-			std::string line = std::string(this->input.begin(), this->input.begin() + position);
+			break;
+		}
+
+		if (result <= 0)
+		{
+			this->close();
 
-			this->input = std::string(this->input.begin() + position + 1, this->input.end());
+			return;
+		}
+
+		std::size_t sent = static_cast<std::size_t>(result);
 
-			if (!this->processCmd(line))
+		if (bulk)
+		{
+			if (this->partial > 0)
+			{
+				this->partial -= sent;
+			}
+			else if (queue[sent - 1] != '\n')
 			{
-				this->processLine(line);
+				this->partial = queue.find('\n', sent) + 1 - sent;
 			}
 		}
 
-		if (this->isConnected())
-		{
-			std::chrono::time_point<std::chrono::high_resolution_clock> currentTime = std::chrono::high_resolution_clock::now();
+		queue.erase(0, sent);
+	}
+}
 
-			float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - this->lastTime).count();
+void TcpSocket::shed()
+{
+	#if defined(POSIX)
 
-			if (time >= 0.1f && !this->pinged)
-			{
-				this->writeCmd('p');
+	if (this->reserve != -1)
+	{
+		::close(this->reserve);
 
-				this->lastTime = std::chrono::high_resolution_clock::now();
+		Socket socket = ::accept(this->socket, nullptr, nullptr);
 
-				this->pinged = true;
-			}
+		if (socket != INVALID_SOCKET)
+		{
+			::close(socket);
+
+			Metrics::count(Metrics::ShedConnections);
 		}
+
+		this->reserve = open("/dev/null", O_RDONLY | O_CLOEXEC);
 	}
+
+	#endif
 }
 
-void TcpSocket::setup(int family)
+void TcpSocket::compact()
 {
-	this->close();
+	std::size_t begin = this->consumed;
 
-	this->socket = ::socket(family, SOCK_STREAM, IPPROTO_TCP);
-
-	if (this->socket == INVALID_SOCKET)
+	if (this->lineIndex < this->lines.size())
 	{
-		throw std::runtime_error("Failed to initialize the TCP socket");
+		begin = this->lines[this->lineIndex].offset;
 	}
-}
 
-void TcpSocket::writeCmd(char cmd)
-{
-	char str[3] = { '\b', cmd, '\0' };
+	this->input.erase(0, begin);
+
+	this->consumed -= begin;
+	this->scanned -= begin;
 
-	this->writeLine(str);
+	this->lines.erase(this->lines.begin(), this->lines.begin() + this->lineIndex);
+
+	this->lineIndex = 0;
+
+	for (auto& line : this->lines)
+	{
+		line.offset -= begin;
+	}
 }
 
-bool TcpSocket::processCmd(const std::string& line)
+bool TcpSocket::processCmd(const StringView& line)
 {
-	if (line.length() > 1)
+	if (line.length > 1)
 	{
-		if (line[0] == '\b')
+		if (line.data[0] == '\b')
 		{
-			char cmd = line[1];
+			char cmd = line.data[1];
 
 			switch (cmd)
 			{
@@ -391,16 +1558,22 @@ bool TcpSocket::processCmd(const std::string& line)
 			{
 				this->writeCmd('a');
 
+				Metrics::count(Metrics::HeartbeatsReceived);
+
 				break;
 			}
 			case 'a':
 			{
-				this->lastTime = std::chrono::high_resolution_clock::now();
-				
-				this->pinged = false;
+				this->pingInterval = std::min(this->pingInterval * 2, HeartbeatMaximumInterval);
+
+				Metrics::count(Metrics::HeartbeatsReceived);
 
 				break;
 			}
+			default:
+			{
+				return false;
+			}
 			}
 
 			return true;
@@ -410,10 +1583,74 @@ bool TcpSocket::processCmd(const std::string& line)
 	return false;
 }
 
-void TcpSocket::processLine(const std::string& line)
+void TcpSocket::processLine(std::size_t offset, std::size_t length, Fragment fragment)
+{
+	this->pingInterval = HeartbeatInterval;
+
+	if (fragment == Whole || fragment == Tail)
+	{
+		Metrics::count(Metrics::LinesReceived);
+	}
+
+	if (length > 0 || fragment != Whole)
+	{
+		this->lines.push_back({ offset, length, fragment });
+	}
+}
+
+void TcpSocket::processChunks()
 {
-	if (line.length() > 0)
+	if (this->chunkSize == 0)
+	{
+		if (this->input.length() - this->consumed >= ReceiveLimit)
+		{
+			Metrics::count(Metrics::OversizedLines);
+
+			this->close();
+		}
+
+		return;
+	}
+
+	while (this->input.length() - this->consumed >= this->chunkSize)
 	{
-		this->lines.push(line);
+		std::size_t length = this->chunkSize;
+
+		for (std::size_t i = 0; i < 3 && (this->input[this->consumed + length] & 0xC0) == 0x80; i++)
+		{
+			length--;
+		}
+
+		this->processLine(this->consumed, length, this->continued ? Body : Head);
+
+		this->consumed += length;
+
+		this->continued = true;
+
+		Metrics::count(Metrics::StreamedChunks);
 	}
 }
+
+const std::size_t TcpSocket::ReceiveSize = 4096;
+
+const std::size_t TcpSocket::ReceiveLimit = 64 * 1024;
+
+const std::size_t TcpSocket::SendLimit = 4 * 1024 * 1024;
+
+const std::size_t TcpSocket::UnixBuffer = 4 * 1024 * 1024;
+
+const std::size_t TcpSocket::MaxParts;
+
+const std::chrono::milliseconds TcpSocket::HeartbeatInterval(2000);
+
+const std::chrono::milliseconds TcpSocket::HeartbeatMaximumInterval(30000);
+
+const std::chrono::milliseconds TcpSocket::HeartbeatTimeout(10000);
+
+const std::chrono::milliseconds TcpSocket::KeepAliveIdle(60000);
+
+std::atomic_bool TcpSocket::keepAlive(false);
+
+const std::chrono::milliseconds Connector::ConnectStagger(250);
+
+const std::chrono::milliseconds Connector::ConnectTimeout(10000);
@@ -22,68 +22,227 @@
 #include <array>
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <cstring>
+#include <cstdio>
 
 #include "network.hpp"
+#include "string-view.hpp"
+#include "channel.hpp"
 
-class TcpSocket
+class Handoff;
+
+class Connector
 {
 public:
-	TcpSocket();
+	Connector(const std::string& address);
+
+	Connector(const std::string& host, unsigned short port);
+
+	~Connector();
+
+	bool process(std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+	bool isConnected() const;
+
+	Socket release();
+
+	const std::string& getDescription() const;
+
+	static const std::chrono::milliseconds ConnectTimeout;
 
 private:
+	void resolve(const std::string& host, unsigned short port);
+
+	void start();
+
+	static const std::chrono::milliseconds ConnectStagger;
+
+	std::vector<Endpoint> endpoints;
+
+	std::vector<Socket> attempts;
 
-	TcpSocket(Socket socket);
+	std::size_t started;
+	std::size_t failed;
 
+	Socket socket;
+
+	std::string description;
+
+	std::chrono::time_point<std::chrono::steady_clock> nextStart;
+	std::chrono::time_point<std::chrono::steady_clock> deadline;
+};
+
+class TcpSocket
+{
 public:
+	enum Fragment
+	{
+		Whole,
+		Head,
+		Body,
+		Tail
+	};
+
+	TcpSocket();
 
 	~TcpSocket();
 
 	void bind(unsigned short port = Network::DefaultPort);
 
+	void bind(const std::string& path);
+
 	bool isBound() const;
 
+	const std::string& getPath() const;
+
 	void listen(int maxConnections = Network::MaxConnections);
 
 	void connect(const std::string& address, unsigned short port);
 
 	void connect(const std::string& address);
 
+	void pair(TcpSocket& tcpSocket, const Channel::Notifier& notifier = Channel::Notifier());
+
 	bool isConnected() const;
 
+	bool isPaired() const;
+
 	bool hasTimedOut() const;
 
 	bool isAvailable() const;
 
+	bool wait(std::chrono::milliseconds timeout, bool writable = false) const;
+
 	std::shared_ptr<TcpSocket> accept();
 
+	bool accept(TcpSocket& tcpSocket);
+
 	bool hasLine();
 
 	std::string readLine();
 
-	void writeLine(const std::string& line);
+	bool readLine(StringView& line);
+
+	bool readLine(StringView& line, Fragment& fragment);
+
+	void unreadLine();
+
+	void writeLine(const StringView& line);
+
+	void writeLine(std::initializer_list<StringView> parts);
+
+	void writeCmd(char cmd, const StringView& argument = StringView());
+
+	std::size_t sendFile(std::FILE* file, unsigned long long offset, std::size_t length);
+
+	std::size_t receiveFile(std::FILE* file, std::size_t length);
+
+	void setNonBlocking(bool enable = true);
+
+	void setStreaming(std::size_t chunkSize);
 
 	void close();
 
+	Socket release();
+
+	void attach(Socket socket);
+
+	void detach();
+
+	void save(Handoff& handoff) const;
+
+	void restore(Handoff& handoff);
+
 	void process();
 
+	static void setKeepAlive(bool enable = true);
+
 private:
-	void setup(int family);
+	struct Line
+	{
+		std::size_t offset;
+		std::size_t length;
+
+		Fragment fragment;
+	};
+
+	void setup();
+
+	void setup(int family, int protocol = IPPROTO_TCP);
+
+	void connectUnix(const std::string& path);
+
+	void flush();
+
+	void shed();
+
+	void compact();
+
+	bool processCmd(const StringView& line);
+
+	void processLine(std::size_t offset, std::size_t length, Fragment fragment);
+
+	void processChunks();
 
-	void writeCmd(char cmd);
+	static const std::size_t ReceiveSize;
 
-	bool processCmd(const std::string& line);
+	static const std::size_t ReceiveLimit;
 
-	void processLine(const std::string& line);
+	static const std::size_t SendLimit;
+
+	static const std::size_t UnixBuffer;
+
+	static const std::size_t MaxParts = 8;
+
+	static const std::chrono::milliseconds HeartbeatInterval;
+
+	static const std::chrono::milliseconds HeartbeatMaximumInterval;
+
+	static const std::chrono::milliseconds HeartbeatTimeout;
+
+	static const std::chrono::milliseconds KeepAliveIdle;
+
+	static std::atomic_bool keepAlive;
 
 	Socket socket;
 
+	int reserve;
+
+	int pipe[2];
+
+	std::string path;
+
+	std::shared_ptr<Channel> inbound;
+	std::shared_ptr<Channel> outbound;
+
+	mutable std::recursive_mutex mutex;
+
 	std::string input;
-	std::queue<std::string> lines;
+	std::size_t consumed;
+	std::size_t scanned;
+
+	std::vector<std::size_t> newlines;
+
+	std::vector<Line> lines;
+	std::size_t lineIndex;
+
+	std::size_t chunkSize;
+	bool continued;
+
+	std::string output;
+	std::string control;
+
+	std::size_t partial;
 
 	bool bound;
-	bool connected;
+	std::atomic_bool connected;
 	bool pinged;
+	bool heartbeats;
+
+	std::chrono::milliseconds pingInterval;
 
-	std::chrono::time_point<std::chrono::high_resolution_clock> lastTime;
+	std::chrono::time_point<std::chrono::high_resolution_clock> lastReceived;
+	std::chrono::time_point<std::chrono::high_resolution_clock> pingTime;
 };
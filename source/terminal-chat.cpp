@@ -15,11 +15,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <fstream>
+
 #include "arguments.hpp"
 
 #include "server.hpp"
 #include "client.hpp"
 
+#include "metrics.hpp"
 #include "terminal.hpp"
 
 std::string msgDefault =
@@ -29,20 +32,233 @@ std::string msgDefault =
 std::string msgHelp =
 "terminal-chat:\n"
 "Help: -? or -help\n"
-"Host: -h [port=1024] -n [name]\n"
-"Join: -j [ip[:port=1024]] -n [name]";
+"Host: -h [port=1024] -n [name] [-backlog [n]] [-peer [ip:port[,ip:port...]] -peersecret [secret]] [-unix [path]]\n"
+"Peering: -peersecret [secret] (with -h, required with -peer, links to and from other servers must present the same secret)\n"
+"Flood control: -flood [messages/s[,bytes/s]] -roomflood [messages/s[,bytes/s]] -floodaction [delay|drop|disconnect] (with -h)\n"
+"Capture: -capture [file] (with -h, records inbound traffic for bin/replay)\n"
+"Hot restart: -control [path] (with -h, takes over the listeners and connections of a server running with the same -control path)\n"
+"Join: -j [ip[:port=1024]|unix:path] -n [name]\n"
+"Bot: -bot [script] (with -h or -j, reads messages from stdin or a script and exits when it ends)\n"
+"Keep-alive: -keepalive (with -h or -j, uses TCP keep-alive for long idle connections)\n"
+"Statistics: type /stats while hosting (with -h, shows the counters of the local server)\n"
+"File transfer: type /send [path] while connected, type /accept [number] to save an offered file in the working directory";
+
+bool hasValidArguments()
+{
+	return Arguments::hasArgument("n") && (Arguments::hasFlag("h") || Arguments::hasFlag("j"));
+}
+
+unsigned short getPort()
+{
+	unsigned short port = Network::DefaultPort;
+
+	if (Arguments::hasArgument("h"))
+	{
+		std::stringstream stream(Arguments::getArgument("h"));
+
+		stream >> port;
+	}
+
+	return port;
+}
+
+int getBacklog()
+{
+	int backlog = Network::MaxConnections;
+
+	if (Arguments::hasArgument("backlog"))
+	{
+		std::stringstream stream(Arguments::getArgument("backlog"));
+
+		stream >> backlog;
+	}
+
+	return backlog;
+}
+
+void getRates(const std::string& argument, double& messages, double& bytes)
+{
+	if (Arguments::hasArgument(argument))
+	{
+		std::stringstream stream(Arguments::getArgument(argument));
+
+		char separator = 0;
+
+		stream >> messages >> separator >> bytes;
+	}
+}
+
+FloodLimits getFloodLimits()
+{
+	FloodLimits limits;
+
+	getRates("flood", limits.messages, limits.bytes);
+
+	getRates("roomflood", limits.roomMessages, limits.roomBytes);
+
+	if (Arguments::hasArgument("floodaction"))
+	{
+		std::string action = Arguments::getArgument("floodaction");
+
+		if (action == "drop")
+		{
+			limits.action = FloodLimits::Drop;
+		}
+		else if (action == "disconnect")
+		{
+			limits.action = FloodLimits::Disconnect;
+		}
+	}
+
+	return limits;
+}
+
+std::shared_ptr<Server> createServer()
+{
+	if (Arguments::hasArgument("peer") && !Arguments::hasArgument("peersecret"))
+	{
+		throw std::runtime_error("-peer requires -peersecret");
+	}
+
+	std::shared_ptr<Server> server(new Server(getPort(), getBacklog(), Arguments::hasArgument("control") ? Arguments::getArgument("control") : std::string()));
+
+	server->setFloodLimits(getFloodLimits());
+
+	if (Arguments::hasArgument("unix"))
+	{
+		server->listenUnix(Arguments::getArgument("unix"), getBacklog());
+	}
+
+	if (Arguments::hasArgument("capture"))
+	{
+		server->setCapture(Arguments::getArgument("capture"));
+	}
+
+	if (Arguments::hasArgument("peersecret"))
+	{
+		server->setPeerSecret(Arguments::getArgument("peersecret"));
+	}
+
+	if (Arguments::hasArgument("peer"))
+	{
+		std::stringstream stream(Arguments::getArgument("peer"));
+
+		std::string address;
+
+		while (std::getline(stream, address, ','))
+		{
+			if (address != "")
+			{
+				server->addPeer(address);
+			}
+		}
+	}
+
+	return server;
+}
+
+std::string getAddress()
+{
+	if (Arguments::hasFlag("h"))
+	{
+		return "localhost:" + std::to_string(getPort());
+	}
+
+	if (Arguments::hasArgument("j"))
+	{
+		return Arguments::getArgument("j");
+	}
+
+	return "localhost";
+}
+
+int runBot()
+{
+	if (!hasValidArguments())
+	{
+		std::cerr << msgDefault << std::endl;
+
+		return 1;
+	}
+
+	try
+	{
+		std::shared_ptr<Server> server;
+
+		if (Arguments::hasFlag("h"))
+		{
+			server = createServer();
+		}
+
+		std::ifstream script;
+
+		if (Arguments::hasArgument("bot"))
+		{
+			script.open(Arguments::getArgument("bot"));
+
+			if (!script.is_open())
+			{
+				throw std::runtime_error("Failed to open " + Arguments::getArgument("bot"));
+			}
+		}
+
+		std::istream& input = script.is_open() ? script : std::cin;
+
+		std::shared_ptr<Client> client(server ? new Client(Arguments::getArgument("n"), *server, getAddress()) : new Client(Arguments::getArgument("n"), getAddress()));
+
+		client->setMessageHandler([](const std::string& message) { std::cout << message << std::endl; });
+
+		client->setDisconnectHandler([](const std::string& reason) { std::cerr << reason << std::endl; });
+
+		std::string line;
+
+		while (!client->isClosed() && std::getline(input, line))
+		{
+			if (line.compare(0, 6, "/send ") == 0)
+			{
+				client->sendFile(line.substr(6));
+			}
+			else if (line.compare(0, 8, "/accept ") == 0)
+			{
+				client->acceptFile(line.substr(8));
+			}
+			else
+			{
+				client->sendMessage(line);
+			}
+		}
+	}
+	catch (const std::runtime_error& runtimeError)
+	{
+		std::cerr << runtimeError.what() << std::endl;
+
+		return 1;
+	}
+
+	return 0;
+}
 
 int main(int argc, char* argv[])
 {
 	Arguments::setArgs(argc, argv);
-	
+
+	if (Arguments::hasFlag("keepalive"))
+	{
+		TcpSocket::setKeepAlive();
+	}
+
+	if (Arguments::hasFlag("bot"))
+	{
+		return runBot();
+	}
+
 	Terminal terminal;
 
 	if (Arguments::hasFlag("help") || Arguments::hasFlag("?"))
 	{
 		terminal.printLine(msgHelp);
 	}
-	else if (!Arguments::hasArgument("n") || (!Arguments::hasFlag("h") && !Arguments::hasFlag("j")))
+	else if (!hasValidArguments())
 	{
 		terminal.printLine(msgDefault);
 	}
@@ -50,12 +266,7 @@ int main(int argc, char* argv[])
 	{
 		std::string name = Arguments::getArgument("n");
 
-		std::string address = "localhost";
-
-		if (Arguments::hasArgument("j"))
-		{
-			address = Arguments::getArgument("j");
-		}
+		std::string address = getAddress();
 
 		try
 		{
@@ -65,20 +276,13 @@ int main(int argc, char* argv[])
 
 			if (Arguments::hasFlag("h"))
 			{
-				unsigned short port = Network::DefaultPort;
-
-				if (Arguments::hasArgument("h"))
-				{
-					std::stringstream stream(Arguments::getArgument("h"));
-
-					stream >> port;
-				}
+				unsigned short port = getPort();
 
 				terminal.printLine("Hosting a chat room on port " + std::to_string(port) + " ...");
 
-				server = std::shared_ptr<Server>(new Server(port));
+				server = createServer();
 
-				client = std::shared_ptr<Client>(new Client(name, "localhost:" + std::to_string(port)));
+				client = std::shared_ptr<Client>(new Client(name, *server, address));
 			}
 			else
 			{
@@ -97,7 +301,31 @@ int main(int argc, char* argv[])
 				{
 					while (terminal.hasLine())
 					{
-						client->sendMessage(terminal.getLine());
+						std::string line = terminal.getLine();
+
+						if (line == "/stats")
+						{
+							if (server)
+							{
+								terminal.printLine(Metrics::report());
+							}
+							else
+							{
+								terminal.printLine("Statistics are only available to the host of the chat room");
+							}
+						}
+						else if (line.compare(0, 6, "/send ") == 0)
+						{
+							client->sendFile(line.substr(6));
+						}
+						else if (line.compare(0, 8, "/accept ") == 0)
+						{
+							client->acceptFile(line.substr(8));
+						}
+						else
+						{
+							client->sendMessage(line);
+						}
 					}
 
 					while (client->hasMessage())
@@ -112,7 +340,7 @@ int main(int argc, char* argv[])
 				}
 			}
 		}
-		catch (std::runtime_error runtimeError)
+		catch (const std::runtime_error& runtimeError)
 		{
 			terminal.printLine(runtimeError.what());
 
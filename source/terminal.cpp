@@ -27,7 +27,7 @@ Coord::Coord(int x, int y) : x(x), y(y)
 
 }
 
-Terminal::Terminal(const std::string& label) : label(label + ": "), process(false)
+Terminal::Terminal(const std::string& label) : label(label + ": "), scrollOffset(0), process(false), pasting(false), escaping(false)
 {
 	signal(SIGINT, this->handlerSignal);
 
@@ -54,6 +54,8 @@ Terminal::Terminal(const std::string& label) : label(label + ": "), process(fals
 
 	tcsetattr(STDIN_FILENO, TCSANOW, &term);
 
+	std::cout << (char)0x1B << "[?2004h" << std::flush;
+
 	#endif
 
 	this->run = true;
@@ -80,6 +82,8 @@ Terminal::~Terminal()
 
 	#elif defined(POSIX)
 
+	std::cout << (char)0x1B << "[?2004l" << std::flush;
+
 	tcsetattr(STDIN_FILENO, TCSANOW, &(this->oldTerm));
 
 	#endif
@@ -167,6 +171,15 @@ void Terminal::printLine(const std::string& line)
 {
 	std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
+	this->history.push(line);
+
+	if (this->scrollOffset > 0)
+	{
+		this->scrollOffset = std::min(this->scrollOffset + 1, this->history.size() - 1);
+
+		return;
+	}
+
 	if (this->process)
 	{
 		this->erase(this->label.length() + this->input.length());
@@ -196,14 +209,7 @@ Coord Terminal::getCursorPosition() const
 
 	#elif defined(POSIX)
 
-	Coord cursorPosition;
-
-	int n = static_cast<int>(this->label.length() + this->input.length());
-
-	cursorPosition.x = n - (n / this->getMaximumSize().x) * this->getMaximumSize().x;
-	cursorPosition.y = n / this->getMaximumSize().x;
-
-	return cursorPosition;
+	return getCursorPosition(this->label.length() + this->input.length(), this->getMaximumSize());
 
 	#endif
 }
@@ -270,101 +276,413 @@ Coord Terminal::getMaximumSize() const
 
 void Terminal::erase(std::size_t n)
 {
-	Coord cursorPosition = this->getCursorPosition();
+	Coord cursorPosition = getErasePosition(this->getCursorPosition(), this->getMaximumSize(), n);
+
+	this->setCursorPosition(cursorPosition);
+
+	#if defined(WINDOWS)
+
+	std::cout << std::string(n, ' ');
+
+	this->setCursorPosition(cursorPosition);
+
+	#elif defined(POSIX)
+
+	std::cout << (char)0x1B << "[s" << std::flush;
+
+	std::cout << std::string(n, ' ');
+
+	std::cout << (char)0x1B << "[u" << std::flush;
+
+	#endif
+}
+
+void Terminal::clear()
+{
+	#if defined(WINDOWS)
+
+	HANDLE hStdout = GetStdHandle(STD_OUTPUT_HANDLE);
+
+	CONSOLE_SCREEN_BUFFER_INFO cbsi;
+
+	GetConsoleScreenBufferInfo(hStdout, &cbsi);
+
+	DWORD cells = static_cast<DWORD>(cbsi.dwSize.X) * static_cast<DWORD>(cbsi.dwSize.Y);
+	DWORD written = 0;
+
+	COORD origin;
+	origin.X = 0;
+	origin.Y = 0;
+
+	FillConsoleOutputCharacter(hStdout, ' ', cells, origin, &written);
+
+	FillConsoleOutputAttribute(hStdout, cbsi.wAttributes, cells, origin, &written);
+
+	SetConsoleCursorPosition(hStdout, origin);
+
+	#elif defined(POSIX)
+
+	std::cout << (char)0x1B << "[2J" << (char)0x1B << "[H" << std::flush;
+
+	#endif
+}
+
+int Terminal::countRows(const std::string& line, int width) const
+{
+	int rows = 0;
+
+	std::size_t begin = 0;
+
+	while (true)
+	{
+		std::size_t end = line.find('\n', begin);
+
+		int length = static_cast<int>((end != std::string::npos ? end : line.length()) - begin);
+
+		rows += std::max(1, (length + width - 1) / width);
 
+		if (end == std::string::npos)
+		{
+			return rows;
+		}
+
+		begin = end + 1;
+	}
+}
+
+void Terminal::render()
+{
 	Coord maximumSize = this->getMaximumSize();
 
-	int x = static_cast<int>(cursorPosition.x);
-	int y = static_cast<int>(cursorPosition.y);
+	int width = std::max(maximumSize.x, 1);
+	int height = std::max(maximumSize.y - (this->scrollOffset > 0 ? 2 : 1), 1);
 
-	int maxX = static_cast<int>(maximumSize.x);
-	int maxY = static_cast<int>(maximumSize.y);
+	std::size_t end = this->history.size() - std::min(this->scrollOffset, this->history.size());
+	std::size_t begin = end;
 
-	int toRemove = static_cast<int>(n);
+	int rows = 0;
 
-	if (toRemove > 0)
+	while (begin > 0)
 	{
-		int xDiff = std::min(toRemove, x);
+		int lineRows = this->countRows(this->history.get(begin - 1), width);
 
-		x -= xDiff;
+		if (rows > 0 && rows + lineRows > height)
+		{
+			break;
+		}
 
-		toRemove -= xDiff;
+		rows += lineRows;
+
+		begin--;
 	}
 
-	if (toRemove && maxX > 0)
+	this->clear();
+
+	for (std::size_t i = begin; i < end; i++)
 	{
-		int yDiff = toRemove / maxX;
+		std::cout << this->history.get(i) << "\n";
+	}
 
-		y -= yDiff;
+	if (this->scrollOffset > 0)
+	{
+		std::cout << "-- " << this->scrollOffset << " more below (Page Down) --\n";
+	}
 
-		toRemove -= yDiff * maxX;
+	std::cout << std::flush;
+
+	if (this->process)
+	{
+		std::cout << this->label << this->input << std::flush;
+
+		this->checkForNewline();
 	}
+}
 
-	if (toRemove)
+void Terminal::scroll(int pages)
+{
+	std::size_t page = static_cast<std::size_t>(std::max(this->getMaximumSize().y - 2, 1));
+
+	if (pages > 0)
 	{
-		x = maxX - toRemove;
+		std::size_t maxOffset = this->history.size() > 0 ? this->history.size() - 1 : 0;
 
-		y -= 1;
+		this->scrollOffset = std::min(this->scrollOffset + page * pages, maxOffset);
 	}
+	else
+	{
+		std::size_t distance = page * -pages;
 
-	cursorPosition = Coord(x, y);
+		this->scrollOffset = this->scrollOffset > distance ? this->scrollOffset - distance : 0;
+	}
 
-	this->setCursorPosition(cursorPosition);
+	this->render();
+}
 
+void Terminal::readInput()
+{
 	#if defined(WINDOWS)
 
-	std::cout << std::string(n, ' ');
+	while (_kbhit())
+	{
+		int code = _getch();
 
-	this->setCursorPosition(cursorPosition);
+		if (code == 0x00 || code == 0xE0)
+		{
+			code = _getch();
+
+			if (code == 0x49)
+			{
+				this->buffer += "\x1B[5~";
+			}
+			else if (code == 0x51)
+			{
+				this->buffer += "\x1B[6~";
+			}
+		}
+		else
+		{
+			this->buffer += static_cast<char>(code);
+		}
+	}
 
 	#elif defined(POSIX)
 
-	std::cout << (char)0x1B << "[s" << std::flush;
+	int available = 0;
 
-	std::cout << std::string(n, ' ');
+	if (ioctl(STDIN_FILENO, FIONREAD, &available) == 0 && available > 0)
+	{
+		std::size_t length = this->buffer.length();
 
-	std::cout << (char)0x1B << "[u" << std::flush;
+		this->buffer.resize(length + available);
+
+		ssize_t n = read(STDIN_FILENO, &(this->buffer[length]), available);
+
+		this->buffer.resize(length + static_cast<std::size_t>(std::max<ssize_t>(n, 0)));
+	}
 
 	#endif
 }
 
-char Terminal::getchar()
+bool Terminal::isFiltered(char c) const
 {
-	char c = '\0';
+	return (c >= 0x00 && c <= 0x1F) && c != '\b' && c != '\n' && c != '\r' && c != 0x1B;
+}
 
-	#if defined(WINDOWS)
+void Terminal::writeEcho(std::string& echo)
+{
+	if (echo.length() > 0)
+	{
+		std::cout << echo << std::flush;
+
+		echo.clear();
+
+		this->checkForNewline();
+	}
+}
+
+void Terminal::submit(const std::string& line, std::string& echo)
+{
+	this->writeEcho(echo);
+
+	if (line.length() > 0)
+	{
+		this->erase(this->input.length());
+
+		this->lines.push(line);
+
+		this->input.clear();
+	}
+}
+
+void Terminal::processChar(char c, std::string& echo)
+{
+	switch (c)
+	{
+	case '\b':
+	case 0x7F:
+	{
+		if (this->input.length() > 0)
+		{
+			this->writeEcho(echo);
+
+			this->erase(1);
 
-	if (_kbhit())
+			this->input.resize(input.length() - 1);
+		}
+
+		break;
+	}
+	case '\n':
+	case '\r':
 	{
-		c = static_cast<char>(_getch());
+		this->submit(this->input, echo);
+
+		break;
 	}
+	default:
+	{
+		this->input.resize(this->input.length() + 1, c);
 
-	#elif defined(POSIX)
+		echo += c;
+
+		break;
+	}
+	}
+}
 
-	struct timeval tv;
-	fd_set rdfs;
+void Terminal::processPaste(std::string& echo)
+{
+	std::string text;
 
-	tv.tv_sec = 0;
-	tv.tv_usec = 0;
+	for (std::size_t i = 0; i < this->paste.length(); i++)
+	{
+		if (this->paste[i] == '\r')
+		{
+			if (i + 1 < this->paste.length() && this->paste[i + 1] == '\n')
+			{
+				continue;
+			}
 
-	FD_ZERO(&rdfs);
-	FD_SET(STDIN_FILENO, &rdfs);
+			text += '\n';
+		}
+		else
+		{
+			text += this->paste[i];
+		}
+	}
+
+	this->paste.clear();
 
-	select(STDIN_FILENO + 1, &rdfs, nullptr, nullptr, &tv);
+	std::size_t end = text.find_last_not_of('\n');
 
-	if (FD_ISSET(STDIN_FILENO, &rdfs) > 0)
+	text.resize(end != std::string::npos ? end + 1 : 0);
+
+	if (text.find('\n') != std::string::npos)
 	{
-		read(STDIN_FILENO, &c, 1);
+		this->submit(this->input + text, echo);
+	}
+	else
+	{
+		for (char c : text)
+		{
+			this->processChar(c, echo);
+		}
 	}
+}
 
-	#endif
+std::size_t Terminal::processEscape(std::size_t position, std::string& echo)
+{
+	std::size_t end = position + 1;
+
+	if (end < this->buffer.length() && this->buffer[end] == '[')
+	{
+		end++;
+
+		while (end < this->buffer.length() && !(this->buffer[end] >= 0x40 && this->buffer[end] <= 0x7E))
+		{
+			end++;
+		}
+	}
+	else if (end < this->buffer.length() && this->buffer[end] == 'O')
+	{
+		end++;
+	}
+
+	if (end >= this->buffer.length())
+	{
+		std::chrono::time_point<std::chrono::steady_clock> now = std::chrono::steady_clock::now();
+
+		if (!this->escaping)
+		{
+			this->escaping = true;
+
+			this->escapeTime = now;
+		}
+
+		if (now - this->escapeTime < EscapeTimeout)
+		{
+			return 0;
+		}
+
+		this->escaping = false;
+
+		if (position + 1 < this->buffer.length())
+		{
+			this->beep(echo);
+
+			return this->buffer.length() - position;
+		}
+
+		if (!this->pasting)
+		{
+			this->exit = true;
+		}
 
-	if ((c >= 0x00 && c <= 0x1F) && c != '\b' && c != 0x7F && c != '\n' && c != '\r' && c != 0x1B)
+		return 1;
+	}
+
+	this->escaping = false;
+
+	if (this->buffer[position + 1] == 0x1B)
 	{
-		c = '\0';
+		if (!this->pasting)
+		{
+			this->exit = true;
+		}
+
+		return 1;
 	}
 
-	return c;
+	if (this->buffer[position + 1] != '[')
+	{
+		if (!this->pasting)
+		{
+			this->beep(echo);
+		}
+
+		return end - position + 1;
+	}
+
+	std::string sequence(this->buffer.begin() + position + 2, this->buffer.begin() + end + 1);
+
+	if (sequence == "200~")
+	{
+		this->pasting = true;
+	}
+	else if (sequence == "201~")
+	{
+		this->pasting = false;
+
+		this->processPaste(echo);
+	}
+	else if (!this->pasting)
+	{
+		if (sequence == "5~")
+		{
+			this->writeEcho(echo);
+
+			this->scroll(1);
+		}
+		else if (sequence == "6~")
+		{
+			this->writeEcho(echo);
+
+			this->scroll(-1);
+		}
+		else
+		{
+			this->beep(echo);
+		}
+	}
+
+	return end - position + 1;
+}
+
+void Terminal::beep(std::string& echo)
+{
+	this->writeEcho(echo);
+
+	std::cout << '\a' << std::flush;
 }
 
 void Terminal::checkForNewline()
@@ -388,68 +706,110 @@ void Terminal::processInput()
 		{
 			std::lock_guard<std::recursive_mutex> lockGuard(this->mutex);
 
-			char c = '\0';
+			this->readInput();
 
-			while ((c = this->getchar()) != '\0')
-			{
-				if (this->process)
-				{
-					switch (c)
-					{
-					case '\b':
-					case 0x7F:
-					{
-						if (this->input.length() > 0)
-						{
-							this->erase(1);
+			std::string echo;
 
-							this->input.resize(input.length() - 1);
-						}
+			std::size_t position = 0;
 
-						break;
-					}
-					case '\n':
-					case '\r':
-					{
-						if (this->input.length() > 0)
-						{
-							this->erase(this->input.length());
-
-							this->lines.push(input);
+			while (position < this->buffer.length())
+			{
+				char c = this->buffer[position];
 
-							this->input.clear();
-						}
+				if (c == 0x1B && this->process)
+				{
+					std::size_t length = this->processEscape(position, echo);
 
-						break;
-					}
-					case 0x1B:
+					if (length == 0)
 					{
-						this->exit = true;
-
 						break;
 					}
-					default:
-					{
-						this->input.resize(this->input.length() + 1, c);
 
-						std::cout << c << std::flush;
+					position += length;
 
-						this->checkForNewline();
+					continue;
+				}
 
-						break;
-					}
-					}
+				position++;
+
+				if (!this->process || this->isFiltered(c))
+				{
+					continue;
+				}
+
+				if (this->pasting)
+				{
+					this->paste += c;
+				}
+				else
+				{
+					this->processChar(c, echo);
 				}
 			}
+
+			this->buffer.erase(0, position);
+
+			this->writeEcho(echo);
 		}
 
 		std::this_thread::sleep_for(std::chrono::milliseconds(10));
 	}
 }
 
-void Terminal::handlerSignal(int signal)
+Coord Terminal::getCursorPosition(std::size_t length, const Coord& maximumSize)
+{
+	int n = static_cast<int>(length);
+
+	if (maximumSize.x <= 0)
+	{
+		return Coord(n, 0);
+	}
+
+	return Coord(n % maximumSize.x, n / maximumSize.x);
+}
+
+Coord Terminal::getErasePosition(const Coord& cursorPosition, const Coord& maximumSize, std::size_t n)
+{
+	int x = cursorPosition.x;
+	int y = cursorPosition.y;
+
+	int maxX = maximumSize.x;
+
+	int toRemove = static_cast<int>(n);
+
+	if (toRemove > 0)
+	{
+		int xDiff = std::min(toRemove, x);
+
+		x -= xDiff;
+
+		toRemove -= xDiff;
+	}
+
+	if (toRemove && maxX > 0)
+	{
+		int yDiff = toRemove / maxX;
+
+		y -= yDiff;
+
+		toRemove -= yDiff * maxX;
+	}
+
+	if (toRemove)
+	{
+		x = maxX - toRemove;
+
+		y -= 1;
+	}
+
+	return Coord(x, y);
+}
+
+void Terminal::handlerSignal(int)
 {
 	exit = true;
 }
 
 std::atomic_bool Terminal::exit;
+
+const std::chrono::milliseconds Terminal::EscapeTimeout(50);
@@ -26,6 +26,7 @@
 #include <atomic>
 #include <csignal>
 #include <string>
+#include <chrono>
 #include <algorithm>
 
 #if defined(WINDOWS)
@@ -52,6 +53,8 @@
 
 #endif
 
+#include "history.hpp"
+
 struct Coord
 {
 public:
@@ -83,6 +86,10 @@ public:
 
 	void printLine(const std::string& line);
 
+	static Coord getCursorPosition(std::size_t length, const Coord& maximumSize);
+
+	static Coord getErasePosition(const Coord& cursorPosition, const Coord& maximumSize, std::size_t n);
+
 private:
 	Coord getCursorPosition() const;
 
@@ -92,7 +99,29 @@ private:
 
 	void erase(std::size_t n);
 
-	char getchar();
+	void clear();
+
+	int countRows(const std::string& line, int width) const;
+
+	void render();
+
+	void scroll(int pages);
+
+	void readInput();
+
+	bool isFiltered(char c) const;
+
+	void writeEcho(std::string& echo);
+
+	void submit(const std::string& line, std::string& echo);
+
+	void processChar(char c, std::string& echo);
+
+	void processPaste(std::string& echo);
+
+	std::size_t processEscape(std::size_t position, std::string& echo);
+
+	void beep(std::string& echo);
 
 	void checkForNewline();
 
@@ -100,17 +129,31 @@ private:
 
 	static void handlerSignal(int signal);
 
+	static const std::chrono::milliseconds EscapeTimeout;
+
 	std::string label;
 
 	std::string input;
 
 	std::queue<std::string> lines;
 
+	History history;
+
+	std::size_t scrollOffset;
+
+	std::string buffer;
+
+	std::string paste;
+
 	std::thread thread;
 	mutable std::recursive_mutex mutex;
 
 	std::atomic_bool run;
 	bool process;
+	bool pasting;
+	bool escaping;
+
+	std::chrono::time_point<std::chrono::steady_clock> escapeTime;
 
 	static std::atomic_bool exit;
 
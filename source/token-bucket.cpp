@@ -0,0 +1,92 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "token-bucket.hpp"
+
+#include <algorithm>
+
+TokenBucket::TokenBucket() : rate(0.0), capacity(0.0), tokens(0.0)
+{
+
+}
+
+void TokenBucket::configure(double rate, double capacity)
+{
+	this->rate = rate;
+	this->capacity = capacity;
+	this->tokens = capacity;
+
+	this->updated = std::chrono::steady_clock::now();
+}
+
+bool TokenBucket::consume(double tokens, const std::chrono::steady_clock::time_point& now)
+{
+	if (!this->isLimited())
+	{
+		return true;
+	}
+
+	if (now > this->updated)
+	{
+		double elapsed = std::chrono::duration<double>(now - this->updated).count();
+
+		this->tokens = std::min(this->capacity, this->tokens + elapsed * this->rate);
+
+		this->updated = now;
+	}
+
+	if (this->tokens < std::min(tokens, this->capacity))
+	{
+		return false;
+	}
+
+	this->tokens -= tokens;
+
+	return true;
+}
+
+void TokenBucket::refund(double tokens)
+{
+	this->tokens = std::min(this->capacity, this->tokens + tokens);
+}
+
+std::chrono::steady_clock::duration TokenBucket::getWait(double tokens) const
+{
+	if (!this->isLimited())
+	{
+		return std::chrono::steady_clock::duration::zero();
+	}
+
+	double missing = std::max(0.0, std::min(tokens, this->capacity) - this->tokens);
+
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(missing / this->rate));
+}
+
+bool TokenBucket::isLimited() const
+{
+	return this->rate > 0.0;
+}
+
+double TokenBucket::getRate() const
+{
+	return this->rate;
+}
+
+double TokenBucket::getCapacity() const
+{
+	return this->capacity;
+}
@@ -0,0 +1,47 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+
+class TokenBucket
+{
+public:
+	TokenBucket();
+
+	void configure(double rate, double capacity);
+
+	bool consume(double tokens, const std::chrono::steady_clock::time_point& now);
+
+	void refund(double tokens);
+
+	std::chrono::steady_clock::duration getWait(double tokens) const;
+
+	bool isLimited() const;
+
+	double getRate() const;
+
+	double getCapacity() const;
+
+private:
+	double rate;
+	double capacity;
+	double tokens;
+
+	std::chrono::steady_clock::time_point updated;
+};
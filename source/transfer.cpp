@@ -0,0 +1,207 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "transfer.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+Transfer::Transfer(const std::string& id, const std::string& sender, const std::string& name, unsigned long long size) : id(id), sender(sender), name(name), size(size), file(std::tmpfile()), received(0), failed(false)
+{
+	if (this->file == nullptr)
+	{
+		throw std::runtime_error("Failed to create a spool file for " + name);
+	}
+}
+
+Transfer::~Transfer()
+{
+	std::fclose(this->file);
+}
+
+const std::string& Transfer::getId() const
+{
+	return this->id;
+}
+
+const std::string& Transfer::getSender() const
+{
+	return this->sender;
+}
+
+const std::string& Transfer::getName() const
+{
+	return this->name;
+}
+
+unsigned long long Transfer::getSize() const
+{
+	return this->size;
+}
+
+unsigned long long Transfer::getReceived() const
+{
+	return this->received;
+}
+
+bool Transfer::isComplete() const
+{
+	return this->received == this->size;
+}
+
+bool Transfer::hasFailed() const
+{
+	return this->failed;
+}
+
+bool Transfer::isFinished() const
+{
+	return this->isComplete() || this->hasFailed();
+}
+
+void Transfer::fail()
+{
+	if (!this->failed.exchange(true))
+	{
+		Metrics::count(Metrics::FailedTransfers);
+	}
+}
+
+bool Transfer::receive(TcpSocket& tcpSocket)
+{
+	unsigned long long received = this->received;
+
+	std::size_t moved = 0;
+
+	while (received < this->size && moved < Batch)
+	{
+		std::size_t length = static_cast<std::size_t>(std::min<unsigned long long>(this->size - received, Batch - moved));
+
+		std::size_t result = tcpSocket.receiveFile(this->file, length);
+
+		if (result == 0)
+		{
+			break;
+		}
+
+		received += result;
+
+		moved += result;
+
+		this->received = received;
+	}
+
+	Metrics::count(Metrics::TransferredBytes, moved);
+
+	if (!this->isComplete() && !tcpSocket.isConnected())
+	{
+		this->fail();
+	}
+
+	return moved > 0;
+}
+
+bool Transfer::send(TcpSocket& tcpSocket, unsigned long long& offset)
+{
+	std::size_t moved = 0;
+
+	while (moved < Batch)
+	{
+		unsigned long long received = this->received;
+
+		if (offset >= received)
+		{
+			break;
+		}
+
+		std::size_t length = static_cast<std::size_t>(std::min<unsigned long long>(received - offset, Batch - moved));
+
+		std::size_t result = tcpSocket.sendFile(this->file, offset, length);
+
+		if (result == 0)
+		{
+			break;
+		}
+
+		offset += result;
+
+		moved += result;
+	}
+
+	Metrics::count(Metrics::TransferredBytes, moved);
+
+	return moved > 0;
+}
+
+std::string Transfer::getFileName(const std::string& path)
+{
+	std::string name = path.substr(path.find_last_of("/\\") + 1);
+
+	if (name.length() > MaxNameLength)
+	{
+		name.erase(0, name.length() - MaxNameLength);
+	}
+
+	for (char& c : name)
+	{
+		if (static_cast<unsigned char>(c) <= ' ' || c == 0x7f)
+		{
+			c = '_';
+		}
+	}
+
+	if (name.empty() || name[0] == '.')
+	{
+		name.insert(0, "file");
+	}
+
+	return name;
+}
+
+unsigned long long Transfer::getFileSize(std::FILE* file)
+{
+	#if defined(WINDOWS)
+
+	struct _stat64 status;
+
+	if (_fstat64(_fileno(file), &status) != 0)
+	{
+		return 0;
+	}
+
+	#elif defined(POSIX)
+
+	struct stat status;
+
+	if (fstat(fileno(file), &status) != 0)
+	{
+		return 0;
+	}
+
+	#endif
+
+	return static_cast<unsigned long long>(status.st_size);
+}
+
+const unsigned long long Transfer::MaxSize = 1024ull * 1024 * 1024;
+
+const std::size_t Transfer::Batch = 1024 * 1024;
+
+const std::size_t Transfer::MaxNameLength = 255;
@@ -0,0 +1,77 @@
+/* terminal-chat - A simple chat application for the terminal
+ * Copyright (C) 2018 Phil Badura
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdio>
+
+#include "tcp-socket.hpp"
+
+class Transfer
+{
+public:
+	Transfer(const std::string& id, const std::string& sender, const std::string& name, unsigned long long size);
+
+	~Transfer();
+
+	const std::string& getId() const;
+
+	const std::string& getSender() const;
+
+	const std::string& getName() const;
+
+	unsigned long long getSize() const;
+
+	unsigned long long getReceived() const;
+
+	bool isComplete() const;
+
+	bool hasFailed() const;
+
+	bool isFinished() const;
+
+	void fail();
+
+	bool receive(TcpSocket& tcpSocket);
+
+	bool send(TcpSocket& tcpSocket, unsigned long long& offset);
+
+	static std::string getFileName(const std::string& path);
+
+	static unsigned long long getFileSize(std::FILE* file);
+
+	static const unsigned long long MaxSize;
+
+	static const std::size_t Batch;
+
+private:
+	static const std::size_t MaxNameLength;
+
+	std::string id;
+	std::string sender;
+	std::string name;
+
+	unsigned long long size;
+
+	std::FILE* file;
+
+	std::atomic<unsigned long long> received;
+
+	std::atomic_bool failed;
+};